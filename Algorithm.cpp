@@ -1,35 +1,317 @@
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <iterator>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "Algorithm.h"
 #include "main.h"
 
 /*
  */
 
 /**
- * std::max_element
- * std::distance
+ * index of the max (or with `std::greater` the min) of the last `window`
+ * pushed samples, i.e. `index_of_max` of every window of a stream.
+ *
+ * monotonic deque: a sample is dropped as soon as a later one is larger,
+ * so the front is always the (first) max of the window.
+ * O(1) amortized per sample.
+ * an empty window has no max, `window` 0 throws std::invalid_argument.
+ *
+ * std::deque
+ */
+template <typename T, typename Compare = std::less<T>>
+class SlidingWindowArg {
+ public:
+  explicit SlidingWindowArg(std::size_t window, Compare comp = Compare())
+      : window(window), comp(comp) {
+    if (window == 0) throw std::invalid_argument("SlidingWindowArg: empty window");
+  }
+
+  void push(const T& value) {
+    while (!candidates.empty() && comp(candidates.back().second, value)) {
+      candidates.pop_back();
+    }
+    candidates.emplace_back(pushed++, value);
+    if (candidates.front().first + window <= pushed - 1) {
+      candidates.pop_front();  // slid out of the window
+    }
+  }
+
+  // index of the max since the first push, requires at least one push
+  std::size_t index() const { return candidates.front().first; }
+  const T& value() const { return candidates.front().second; }
+  // number of pushed samples in the window
+  std::size_t size() const { return std::min(pushed, window); }
+
+ private:
+  std::size_t window;
+  Compare comp;
+  std::size_t pushed = 0;
+  std::deque<std::pair<std::size_t, T>> candidates;  // (index, value)
+};
+
+template <typename T>
+using SlidingWindowMax = SlidingWindowArg<T, std::less<T>>;
+template <typename T>
+using SlidingWindowMin = SlidingWindowArg<T, std::greater<T>>;
+
+/**
+ * the `k` largest of all pushed samples.
+ *
+ * bounded min-heap of size `k`: a sample not larger than the smallest kept one
+ * is rejected with a single compare. O(log k) per accepted sample.
+ *
+ * std::push_heap
+ * std::pop_heap
+ * std::sort_heap
+ */
+template <typename T, typename Compare = std::less<T>>
+class TopK {
+ public:
+  explicit TopK(std::size_t k, Compare comp = Compare()) : k(k), comp(comp) {
+    heap.reserve(k);
+  }
+
+  void push(const T& value) {
+    if (heap.size() < k) {
+      heap.push_back(value);
+      std::push_heap(heap.begin(), heap.end(), greater());
+    } else if (k > 0 && comp(heap.front(), value)) {
+      std::pop_heap(heap.begin(), heap.end(), greater());
+      heap.back() = value;
+      std::push_heap(heap.begin(), heap.end(), greater());
+    }
+  }
+
+  // the smallest of the top k, requires at least one push
+  const T& threshold() const { return heap.front(); }
+  std::size_t size() const { return heap.size(); }
+
+  // largest first
+  std::vector<T> sorted() const {
+    auto result = heap;
+    std::sort_heap(result.begin(), result.end(), greater());
+    return result;
+  }
+
+ private:
+  auto greater() const {
+    return [this](const T& a, const T& b) { return comp(b, a); };
+  }
+
+  std::size_t k;
+  Compare comp;
+  std::vector<T> heap;
+};
+
+namespace radix_detail {
+
+/*
+ * order preserving map of a key to an unsigned integer
+ * - signed: flip the sign bit
+ * - floating point: flip all bits of negatives, the sign bit of positives
+ */
+template <typename T, typename = void>
+struct Key;
+
+template <typename T>
+struct Key<T, std::enable_if_t<std::is_integral_v<T>>> {
+  using U = std::make_unsigned_t<T>;
+  static U encode(T x) {
+    if constexpr (std::is_signed_v<T>) {
+      return static_cast<U>(x) ^ (U(1) << (8 * sizeof(U) - 1));
+    } else {
+      return x;
+    }
+  }
+};
+
+template <typename T>
+struct Key<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+  static_assert(sizeof(T) == 4 || sizeof(T) == 8, "float or double");
+  using U = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+  static U encode(T x) {
+    U bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    constexpr U sign = U(1) << (8 * sizeof(U) - 1);
+    return (bits & sign) ? ~bits : (bits | sign);
+  }
+};
+
+constexpr std::size_t kRadix = 256;
+constexpr std::size_t kMinPerThread = 1 << 14;
+
+using Histogram = std::array<std::size_t, kRadix>;
+
+template <typename F>
+void parallel_for(unsigned threads, F&& f) {
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < threads; ++t) workers.emplace_back(f, t);
+  f(0u);
+  for (auto& worker : workers) worker.join();
+}
+
+/*
+ * one counting pass from `src` to `dst` over the digit at `shift`,
+ * every thread scatters its own chunk through small per-bucket buffers
+ * which are flushed a cache line at a time (software write combining).
+ */
+template <typename T>
+void scatter(const T* src, T* dst, std::size_t n, unsigned shift,
+             unsigned threads, const std::vector<Histogram>& histograms) {
+  using K = Key<T>;
+  constexpr std::size_t kLane = std::max<std::size_t>(1, 64 / sizeof(T));
+
+  // exclusive prefix sum over (digit, thread): stable
+  std::vector<Histogram> offsets(threads);
+  std::size_t sum = 0;
+  for (std::size_t d = 0; d < kRadix; ++d) {
+    for (unsigned t = 0; t < threads; ++t) {
+      offsets[t][d] = sum;
+      sum += histograms[t][d];
+    }
+  }
+
+  parallel_for(threads, [&](unsigned t) {
+    struct alignas(64) Lane {
+      T items[kLane];
+    };
+    std::vector<Lane> lanes(kRadix);
+    std::array<std::uint8_t, kRadix> fill{};
+    auto pos = offsets[t];
+    const std::size_t first = n * t / threads;
+    const std::size_t last = n * (t + 1) / threads;
+    for (std::size_t i = first; i < last; ++i) {
+      const auto d = (K::encode(src[i]) >> shift) & (kRadix - 1);
+      lanes[d].items[fill[d]++] = src[i];
+      if (fill[d] == kLane) {
+        std::copy_n(lanes[d].items, kLane, dst + pos[d]);
+        pos[d] += kLane;
+        fill[d] = 0;
+      }
+    }
+    for (std::size_t d = 0; d < kRadix; ++d) {
+      std::copy_n(lanes[d].items, fill[d], dst + pos[d]);
+    }
+  });
+}
+
+/*
+ * LSD radix sort, returns true if the result ended up in `tmp`
  */
 template <typename T>
-auto index_of_max(const std::vector<T>& v) {
-  const auto iter_to_max = std::max_element(v.begin(), v.end());
-  return std::distance(v.begin(), iter_to_max);
+bool sort(std::vector<T>& v, std::vector<T>& tmp, unsigned threads) {
+  using K = Key<T>;
+  const std::size_t n = v.size();
+  threads = std::max(1u, std::min<unsigned>(threads, n / kMinPerThread));
+  tmp.resize(n);
+
+  T* src = v.data();
+  T* dst = tmp.data();
+  std::vector<Histogram> histograms(threads);
+  for (unsigned shift = 0; shift < 8 * sizeof(T); shift += 8) {
+    parallel_for(threads, [&](unsigned t) {
+      auto& h = histograms[t];
+      h.fill(0);
+      const std::size_t last = n * (t + 1) / threads;
+      for (std::size_t i = n * t / threads; i < last; ++i) {
+        ++h[(K::encode(src[i]) >> shift) & (kRadix - 1)];
+      }
+    });
+    // all keys share this digit: the pass would not move anything
+    bool trivial = false;
+    for (std::size_t d = 0; d < kRadix && !trivial; ++d) {
+      std::size_t count = 0;
+      for (const auto& h : histograms) count += h[d];
+      trivial = count == n;
+    }
+    if (trivial) continue;
+
+    scatter(src, dst, n, shift, threads, histograms);
+    std::swap(src, dst);
+  }
+  return src != v.data();
 }
 
+}  // namespace radix_detail
+
 /**
- * std::adjacent_find
- * std::not_equal_to
+ * LSD radix sort of 8/16/32/64 bit integer and float/double keys,
+ * multi-threaded with per-thread histograms.
+ * (-0.0 sorts before 0.0, NaNs by their bits)
+ *
+ * all_equal: uniform input is sorted already
  */
 template <typename T>
-bool all_equal(const std::vector<T>& v) {
-  return std::adjacent_find(v.begin(), v.end(), std::not_equal_to<T>()) ==
-         v.end();
+void radix_sort(std::vector<T>& v,
+                unsigned threads = std::thread::hardware_concurrency()) {
+  if (all_equal(v)) return;
+  std::vector<T> tmp;
+  if (radix_detail::sort(v, tmp, threads)) v.swap(tmp);
+}
+
+/**
+ * radix sort and remove duplicates, i.e. std::sort + std::unique.
+ *
+ * if the sorted keys end up in the scratch buffer, the copy back is fused
+ * with the dedup pass (std::unique_copy).
+ * all_equal: uniform input reduces to its first element
+ */
+template <typename T>
+void radix_sort_unique(std::vector<T>& v,
+                       unsigned threads = std::thread::hardware_concurrency()) {
+  if (all_equal(v)) {
+    v.resize(std::min<std::size_t>(v.size(), 1));
+    return;
+  }
+  std::vector<T> tmp;
+  if (radix_detail::sort(v, tmp, threads)) {
+    v.erase(std::unique_copy(tmp.begin(), tmp.end(), v.begin()), v.end());
+  } else {
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+  }
 }
 
 namespace Algorithm {
 
+// the same keys in the same order as std::sort, not merely sorted ones
+template <typename T>
+bool sorts_like_std(std::vector<T> v, unsigned threads) {
+  auto expected = v;
+  std::sort(expected.begin(), expected.end());
+  auto unique = v;
+  radix_sort(v, threads);
+  radix_sort_unique(unique, threads);
+  const bool sorted = v == expected;
+  expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+  return sorted && unique == expected;
+}
+
+template <typename T>
+std::vector<T> random_keys(std::size_t n, T lo, T hi) {
+  std::mt19937_64 gen(n);
+  std::vector<T> v(n);
+  if constexpr (std::is_floating_point_v<T>) {
+    std::uniform_real_distribution<T> dist(lo, hi);
+    for (auto& x : v) x = dist(gen);
+  } else {
+    std::uniform_int_distribution<T> dist(lo, hi);
+    for (auto& x : v) x = dist(gen);
+  }
+  return v;
+}
+
 //
 
 int main() {
@@ -47,6 +329,147 @@ int main() {
   CHECK_VALUE("mismatch", 1, *pair_to_mismatch.first);
   CHECK_VALUE("mismatch", 4, *pair_to_mismatch.second);
 
+  {
+    // sliding window: index_of_max of every window, with streaming
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 99);
+    std::vector<int> series(1000);
+    for (auto& x : series) x = dist(gen);
+
+    constexpr std::size_t window = 16;
+    SlidingWindowMax<int> max(window);
+    SlidingWindowMin<int> min(window);
+    for (std::size_t i = 0; i < series.size(); ++i) {
+      max.push(series[i]);
+      min.push(series[i]);
+      const auto first = i + 1 < window ? 0 : i + 1 - window;
+      const auto begin = series.begin() + first;
+      const auto end = series.begin() + i + 1;
+      if (max.index() != first + index_of_max(begin, end) ||
+          min.index() != first + std::distance(begin, std::min_element(begin, end))) {
+        CHECK_FAILED("sliding window");
+      }
+    }
+    CHECK_VALUE("sliding window", max.size(), window);
+    try {
+      SlidingWindowMax<int> empty(0);
+      CHECK_FAILED("empty window");
+    } catch (const std::invalid_argument&) {
+    }
+
+    // top k
+    TopK<int> top(5);
+    for (auto x : series) top.push(x);
+    auto sorted = series;
+    std::sort(sorted.begin(), sorted.end(), std::greater<int>());
+    sorted.resize(5);
+    CHECK("top k", (top.sorted() == sorted));
+    CHECK_VALUE("top k", top.threshold(), sorted.back());
+
+    TopK<int> few(5);
+    few.push(3);
+    few.push(1);
+    CHECK("top k", (few.sorted() == std::vector<int>{3, 1}));
+  }
+
+  {
+    // radix sort
+    CHECK("radix_sort", sorts_like_std(random_keys<std::uint32_t>(1000, 0, ~0u), 1));
+    CHECK("radix_sort", sorts_like_std(random_keys<std::int32_t>(1000, -500, 500), 1));
+    CHECK("radix_sort", sorts_like_std(random_keys<std::int64_t>(1000, INT64_MIN, INT64_MAX), 1));
+    CHECK("radix_sort", sorts_like_std(random_keys<std::uint64_t>(1000, 0, 1 << 20), 1));
+    CHECK("radix_sort", sorts_like_std(random_keys<float>(1000, -1e6f, 1e6f), 1));
+    CHECK("radix_sort", sorts_like_std(random_keys<double>(1000, -1.0, 1.0), 1));
+    CHECK("radix_sort", sorts_like_std(random_keys<std::int16_t>(1000, -9, 9), 1));
+    // digits shared by all keys are skipped: an odd number of passes (the
+    // result is in the scratch buffer) and an even one
+    {
+      auto keys = random_keys<std::uint32_t>(1000, 0, 255);
+      for (auto& k : keys) k = 0x7F001234u | (k << 16);
+      CHECK("radix_sort skip", sorts_like_std(keys, 1));
+      CHECK("radix_sort skip", sorts_like_std(random_keys<std::int32_t>(1000, -300, -1), 1));
+      CHECK("radix_sort skip", sorts_like_std(random_keys<std::int64_t>(1000, -1, 0), 1));
+      std::vector<std::int64_t> uniform(1000, -42), tmp;
+      CHECK("radix_sort skip", (!radix_detail::sort(uniform, tmp, 1) && uniform == std::vector<std::int64_t>(1000, -42)));
+      CHECK("radix_sort", sorts_like_std(std::vector<double>(), 1));
+      CHECK("radix_sort", sorts_like_std(std::vector<double>(5, -1.5), 1));
+    }
+    // multi-threaded
+    CHECK("radix_sort", sorts_like_std(random_keys<std::int32_t>(100000, -1000, 1000), 4));
+    CHECK("radix_sort", sorts_like_std(random_keys<double>(100000, -1e9, 1e9), 4));
+
+    std::vector<int> uniform(10, 7);
+    radix_sort_unique(uniform);
+    CHECK("radix_sort_unique", (uniform == std::vector<int>{7}));
+    std::vector<int> empty;
+    radix_sort_unique(empty);
+    CHECK("radix_sort_unique", empty.empty());
+  }
+
+  // benchmark (see cache behavior in the counters of the report)
+  std::vector<int> large(1 << 20);
+  std::iota(large.begin(), large.end(), 0);
+  Harness::benchmark("index_of_max", [&] {
+    Harness::doNotOptimize(index_of_max(large));
+  });
+  Harness::sweep("index_of_max", large.size(), [&](unsigned worker, unsigned workers) {
+    const auto first = large.begin() + large.size() * worker / workers;
+    const auto last = large.begin() + large.size() * (worker + 1) / workers;
+    Harness::doNotOptimize(index_of_max(first, last));
+  });
+
+  const std::vector<int> uniform(1 << 20, 42);
+  Harness::benchmark("all_equal", [&] {
+    Harness::doNotOptimize(all_equal(uniform));
+  });
+  Harness::sweep("all_equal", uniform.size(), [&](unsigned worker, unsigned workers) {
+    // overlap by one element so the slices cover every adjacent pair
+    const auto first = uniform.begin() + uniform.size() * worker / workers;
+    const auto last = uniform.begin() + uniform.size() * (worker + 1) / workers;
+    Harness::doNotOptimize(
+        std::adjacent_find(first, last == uniform.end() ? last : last + 1,
+                           std::not_equal_to<int>()));
+  });
+
+  std::vector<int> series(1 << 15);
+  std::mt19937 gen(7);
+  for (auto& x : series) x = static_cast<int>(gen());
+  constexpr std::size_t window = 128;
+  Harness::benchmark("index_of_max per window", [&] {
+    std::size_t sum = 0;
+    for (std::size_t i = window; i <= series.size(); ++i) {
+      sum += index_of_max(series.begin() + (i - window), series.begin() + i);
+    }
+    Harness::doNotOptimize(sum);
+  });
+  Harness::benchmark("SlidingWindowMax", [&] {
+    SlidingWindowMax<int> max(window);
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < series.size(); ++i) {
+      max.push(series[i]);
+      if (i + 1 >= window) sum += max.index() - (i + 1 - window);
+    }
+    Harness::doNotOptimize(sum);
+  });
+  const auto keys = random_keys<std::uint32_t>(1 << 18, 0, 1 << 20);
+  Harness::benchmark("std::sort + std::unique", [&] {
+    auto v = keys;
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+    Harness::doNotOptimize(v);
+  });
+  Harness::benchmark("radix_sort_unique", [&] {
+    auto v = keys;
+    radix_sort_unique(v);
+    Harness::doNotOptimize(v);
+  });
+
+  Harness::benchmark("TopK", [&] {
+    TopK<int> top(100);
+    for (auto x : series) top.push(x);
+    Harness::doNotOptimize(top.threshold());
+  });
+
   return 0;
 }
 
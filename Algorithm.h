@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * generic helpers of Algorithm.cpp, for any range with input iterators
+ * (containers as well as lazy views, see DesignPattern::Adapter)
+ */
+
+/**
+ * std::max_element
+ * std::distance
+ *
+ * a single pass input iterator (a lazy view or an expression template, whose
+ * elements are computed on dereference) cannot be read twice, the current
+ * maximum is kept as a value instead. std::max_element would also recompute
+ * it for every comparison.
+ */
+template <typename Iter>
+auto index_of_max(Iter first, Iter last) {
+  using Traits = std::iterator_traits<Iter>;
+  if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename Traits::iterator_category>) {
+    const auto iter_to_max = std::max_element(first, last);
+    return std::distance(first, iter_to_max);
+  } else {
+    typename Traits::difference_type index = 0, max_index = 0;
+    if (first == last) return max_index;
+    typename Traits::value_type max = *first;
+    for (++first, ++index; first != last; ++first, ++index) {
+      typename Traits::value_type value = *first;
+      if (max < value) {
+        max = std::move(value);
+        max_index = index;
+      }
+    }
+    return max_index;
+  }
+}
+
+template <typename Range>
+auto index_of_max(const Range& r) {
+  return index_of_max(std::begin(r), std::end(r));
+}
+
+/**
+ * std::adjacent_find
+ * std::not_equal_to
+ *
+ * a single pass input iterator cannot be read twice, its elements are
+ * compared against the first one instead.
+ */
+template <typename Iter>
+bool all_equal(Iter first, Iter last) {
+  using Category = typename std::iterator_traits<Iter>::iterator_category;
+  if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+    return std::adjacent_find(first, last, std::not_equal_to<>()) == last;
+  } else {
+    if (first == last) return true;
+    const auto value = *first;
+    for (++first; first != last; ++first) {
+      if (!(*first == value)) return false;
+    }
+    return true;
+  }
+}
+
+template <typename Range>
+bool all_equal(const Range& r) {
+  return all_equal(std::begin(r), std::end(r));
+}
+
+template <typename T>
+bool all_equal(const std::vector<T>& v) {
+  return all_equal(v.begin(), v.end());
+}
@@ -0,0 +1,79 @@
+#include <stdexcept>
+#include <string>
+
+#include "Coroutine.h"
+#include "main.h"
+
+/*
+ * - a `task` does nothing until it is awaited (lazy)
+ * - `co_await pool.schedule()` moves the rest of a coroutine onto a pool thread
+ * - `when_all` starts every task and resumes when the last one completes
+ * - `sync_wait` bridges from ordinary code into coroutines
+ *
+ * https://en.cppreference.com/w/cpp/language/coroutines
+ */
+
+namespace Coroutine {
+
+#ifdef HAS_COROUTINE
+
+task<int> answer() { co_return 42; }
+
+task<int> twice(task<int> t) { co_return 2 * co_await t; }
+
+task<std::thread::id> where(ThreadPool& pool) {
+  co_await pool.schedule();
+  co_return std::this_thread::get_id();
+}
+
+task<> fail(ThreadPool& pool) {
+  co_await pool.schedule();
+  throw std::runtime_error("failed");
+}
+
+task<std::string> concat(ThreadPool& pool, std::string a, std::string b) {
+  auto [x, y, _] = co_await when_all(
+      [](ThreadPool& pool, std::string s) -> task<std::string> {
+        co_await pool.schedule();
+        co_return s;
+      }(pool, a),
+      [](ThreadPool& pool, std::string s) -> task<std::string> {
+        co_await pool.schedule();
+        co_return s;
+      }(pool, b),
+      [](ThreadPool& pool) -> task<> { co_await pool.schedule(); }(pool));
+  co_return x + y;
+}
+
+#endif
+
+int main() {
+#ifdef HAS_COROUTINE
+  CHECK_VALUE("sync_wait", sync_wait(answer()), 42);
+  CHECK_VALUE("co_await", sync_wait(twice(answer())), 84);
+
+  ThreadPool pool(3);
+  CHECK("schedule", (sync_wait(where(pool)) != std::this_thread::get_id()));
+
+  // results of all tasks, a void result as std::monostate
+  auto [a, b, c] = sync_wait(when_all(answer(), twice(answer()), where(pool)));
+  CHECK_VALUE("when_all", a, 42);
+  CHECK_VALUE("when_all", b, 84);
+  CHECK("when_all", (c != std::this_thread::get_id()));
+  CHECK_VALUE("when_all", sync_wait(concat(pool, "Peace", " and Love")),
+              "Peace and Love");
+
+  // an exception is rethrown to the awaiting coroutine
+  try {
+    sync_wait(when_all(answer(), fail(pool)));
+    CHECK_FAILED("exception");
+  } catch (const std::runtime_error& e) {
+    CHECK_VALUE("exception", std::string(e.what()), "failed");
+  }
+#else
+  SKIPPED("Coroutine", "needs -std=c++20 (make STD=c++20)");
+#endif
+  return 0;
+}
+
+}  // namespace Coroutine
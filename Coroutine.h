@@ -0,0 +1,297 @@
+#pragma once
+
+/*
+ * C++20 coroutine support: a lazy `task<T>`, `when_all`, `sync_wait` and a
+ * thread pool to resume coroutines on.
+ *
+ * Only available in the C++20 build mode (`make STD=c++20`),
+ * check `HAS_COROUTINE` before use.
+ *
+ * https://en.cppreference.com/w/cpp/language/coroutines
+ * https://lewissbaker.github.io/2020/05/11/understanding_symmetric_transfer
+ */
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define HAS_COROUTINE 1
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace Coroutine {
+
+template <typename T = void>
+class task;
+
+namespace detail {
+
+struct promise_base {
+  // resumed when the task completes (symmetric transfer)
+  std::coroutine_handle<> continuation = std::noop_coroutine();
+  std::exception_ptr exception;
+
+  struct final_awaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+      return h.promise().continuation;
+    }
+    void await_resume() noexcept {}
+  };
+
+  // lazy: nothing runs until the task is awaited
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  final_awaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() noexcept { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct promise : promise_base {
+  std::optional<T> value;
+
+  task<T> get_return_object() noexcept;
+  template <typename U>
+  void return_value(U&& v) {
+    value.emplace(std::forward<U>(v));
+  }
+  T result() {
+    if (exception) std::rethrow_exception(exception);
+    return std::move(*value);
+  }
+};
+
+template <>
+struct promise<void> : promise_base {
+  task<void> get_return_object() noexcept;
+  void return_void() noexcept {}
+  void result() {
+    if (exception) std::rethrow_exception(exception);
+  }
+};
+
+/**
+ * eagerly started, self destroying coroutine, used to drive tasks
+ */
+struct detached {
+  struct promise_type {
+    detached get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+/**
+ * awaits completion of a task without taking its result (or exception)
+ */
+template <typename T>
+struct ready_awaiter {
+  task<T>& t;
+  bool await_ready() noexcept { return t.await_ready(); }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+    return t.await_suspend(h);
+  }
+  void await_resume() noexcept {}
+};
+
+template <typename T>
+using non_void_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+template <typename T>
+non_void_t<T> take(task<T>& t) {
+  if constexpr (std::is_void_v<T>) {
+    t.await_resume();
+    return {};
+  } else {
+    return t.await_resume();
+  }
+}
+
+}  // namespace detail
+
+/**
+ * lazily started coroutine producing a `T`
+ */
+template <typename T>
+class [[nodiscard]] task {
+ public:
+  using promise_type = detail::promise<T>;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  explicit task(handle_type h) noexcept : h(h) {}
+  task(task&& other) noexcept : h(std::exchange(other.h, {})) {}
+  task& operator=(task&& other) noexcept {
+    if (this != &other) {
+      if (h) h.destroy();
+      h = std::exchange(other.h, {});
+    }
+    return *this;
+  }
+  task(const task&) = delete;
+  task& operator=(const task&) = delete;
+  ~task() {
+    if (h) h.destroy();
+  }
+
+  // awaitable
+  bool await_ready() const noexcept { return !h || h.done(); }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    h.promise().continuation = awaiting;
+    return h;
+  }
+  T await_resume() { return h.promise().result(); }
+
+ private:
+  handle_type h;
+};
+
+namespace detail {
+template <typename T>
+task<T> promise<T>::get_return_object() noexcept {
+  return task<T>{std::coroutine_handle<promise<T>>::from_promise(*this)};
+}
+inline task<void> promise<void>::get_return_object() noexcept {
+  return task<void>{std::coroutine_handle<promise<void>>::from_promise(*this)};
+}
+
+/**
+ * starts all tasks, the last one to complete resumes the awaiting coroutine
+ */
+template <typename... Ts>
+struct when_all_latch {
+  std::tuple<task<Ts>&...> tasks;
+  std::atomic<std::size_t> count{sizeof...(Ts) + 1};
+  std::coroutine_handle<> awaiting{};
+
+  bool arrive() noexcept {
+    return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+
+  template <typename T>
+  static detached start(task<T>& t, when_all_latch& latch) {
+    co_await ready_awaiter<T>{t};
+    if (latch.arrive()) latch.awaiting.resume();
+  }
+
+  bool await_ready() noexcept { return sizeof...(Ts) == 0; }
+  bool await_suspend(std::coroutine_handle<> h) noexcept {
+    awaiting = h;
+    std::apply([this](auto&... t) { (start(t, *this), ...); }, tasks);
+    return !arrive();  // all done already: do not suspend
+  }
+  void await_resume() noexcept {}
+};
+
+}  // namespace detail
+
+/**
+ * fixed number of threads resuming scheduled coroutines.
+ *
+ *   co_await pool.schedule();  // continue on a pool thread
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency()) {
+    if (threads == 0) threads = 1;
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers.emplace_back([this] { run(); });
+    }
+  }
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    ready.notify_all();
+    for (auto& worker : workers) worker.join();
+  }
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  auto schedule() noexcept {
+    struct awaiter {
+      ThreadPool& pool;
+      bool await_ready() noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> h) { pool.enqueue(h); }
+      void await_resume() noexcept {}
+    };
+    return awaiter{*this};
+  }
+
+  std::size_t size() const noexcept { return workers.size(); }
+
+ private:
+  void enqueue(std::coroutine_handle<> h) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(h);
+    }
+    ready.notify_one();
+  }
+
+  void run() {
+    for (;;) {
+      std::coroutine_handle<> h;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;  // stopping and drained
+        h = queue.front();
+        queue.pop_front();
+      }
+      h.resume();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<std::coroutine_handle<>> queue;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+};
+
+/**
+ * run all tasks concurrently (as far as they schedule themselves elsewhere)
+ * and resume with all results, `void` results become `std::monostate`.
+ */
+template <typename... Ts>
+task<std::tuple<detail::non_void_t<Ts>...>> when_all(task<Ts>... tasks) {
+  co_await detail::when_all_latch<Ts...>{std::tie(tasks...)};
+  co_return std::tuple<detail::non_void_t<Ts>...>{detail::take(tasks)...};
+}
+
+/**
+ * block the calling thread until the task completes
+ */
+template <typename T>
+T sync_wait(task<T> t) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = false;
+
+  auto drive = [&]() -> detail::detached {
+    co_await detail::ready_awaiter<T>{t};
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    cv.notify_one();
+  };
+  drive();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return done; });
+  return t.await_resume();
+}
+
+}  // namespace Coroutine
+
+#endif
@@ -1,6 +1,18 @@
 #include "main.h"
+#include "Algorithm.h"
+#include "Coroutine.h"
 
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 #include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace DesignPattern {
 
@@ -17,9 +29,10 @@ namespace FactoryMethod
   // a complicated world
   struct World
   {
-    void developCulture(std::string idea) { /* .... */ }
-    void embraceNature(std::string idea)  { /* .... */ }
-    void everyoneCounts(std::string idea) { /* ... */ }
+    virtual ~World() = default;
+    virtual void developCulture(std::string idea) { /* .... */ }
+    virtual void embraceNature(std::string idea)  { /* .... */ }
+    virtual void everyoneCounts(std::string idea) { /* ... */ }
     std::string futureBasedOn()
     {
       auto idea = withLeadership()->hasIdea();
@@ -29,9 +42,32 @@ namespace FactoryMethod
       return idea;
     }
 
+#ifdef HAS_COROUTINE
+    // the stages are independent consumers of the same idea,
+    // so they can all run at the same time on the pool
+    Coroutine::task<std::string> futureBasedOnConcurrently(Coroutine::ThreadPool& pool)
+    {
+      auto idea = withLeadership()->hasIdea();
+      co_await Coroutine::when_all(stage(pool, &World::developCulture, idea),
+                                   stage(pool, &World::embraceNature, idea),
+                                   stage(pool, &World::everyoneCounts, idea));
+      co_return idea;
+    }
+#endif
+
   protected:
     // this is our "factory method" to produce our leadership value
     virtual std::unique_ptr<Leadership> withLeadership() = 0;
+
+#ifdef HAS_COROUTINE
+  private:
+    Coroutine::task<> stage(Coroutine::ThreadPool& pool,
+                            void (World::*develop)(std::string), std::string idea)
+    {
+      co_await pool.schedule();
+      (this->*develop)(std::move(idea));
+    }
+#endif
   };
 
   // an identical world but with just different leadership
@@ -51,6 +87,15 @@ namespace FactoryMethod
       return std::make_unique<LalaLama>();
     }
   };
+
+  // the same world where every stage takes its time (think of I/O)
+  struct SlowUtopia : Utopia
+  {
+    static constexpr auto cost = std::chrono::milliseconds(2);
+    void developCulture(std::string idea) override { std::this_thread::sleep_for(cost); }
+    void embraceNature(std::string idea) override  { std::this_thread::sleep_for(cost); }
+    void everyoneCounts(std::string idea) override { std::this_thread::sleep_for(cost); }
+  };
 }
 
 namespace AbstractFactory
@@ -202,7 +247,242 @@ namespace Singleton
 
 namespace Adapter
 {
-  // TODO:
+  // An adapter makes one interface look like another one without touching either.
+  // Here iterator adapters make a range look like a filtered, transformed, ... range:
+  //
+  //   numbers | filter(odd) | transform(square) | take(3)
+  //
+  // is a lazy view. Nothing happens until it is iterated, e.g. by `index_of_max`,
+  // and then every element flows through all stages in a single pass
+  // without any intermediate container.
+
+  // a view refers to an lvalue range and owns an rvalue one (e.g. another view)
+  template<typename R>
+  struct Ref
+  {
+    R* r;
+    auto begin() const { return std::begin(*r); }
+    auto end() const { return std::end(*r); }
+  };
+
+  template<typename R>
+  auto stored(R&& r)
+  {
+    if constexpr (std::is_lvalue_reference_v<R>) return Ref<std::remove_reference_t<R>>{&r};
+    else return std::decay_t<R>(std::move(r));
+  }
+
+  template<typename R>
+  using Stored = decltype(stored(std::declval<R>()));
+
+  template<typename V>
+  using IteratorOf = decltype(std::begin(std::declval<const V&>()));
+
+  template<typename It>
+  struct Subrange
+  {
+    It first, last;
+    It begin() const { return first; }
+    It end() const { return last; }
+  };
+
+  // common iterator boilerplate, `Derived` provides `operator*`, `next()` and `equal()`.
+  // an element computed on dereference is a value, not a reference,
+  // which only makes an input iterator
+  template<typename Derived, typename Reference>
+  struct IteratorBase
+  {
+    using iterator_category = std::conditional_t<std::is_reference_v<Reference>,
+                                                 std::forward_iterator_tag, std::input_iterator_tag>;
+    using value_type = std::decay_t<Reference>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Reference;
+
+    Derived& operator++() { self().next(); return self(); }
+    Derived operator++(int) { auto tmp = self(); self().next(); return tmp; }
+    bool operator==(const Derived& other) const { return self().equal(other); }
+    bool operator!=(const Derived& other) const { return !self().equal(other); }
+
+  private:
+    Derived& self() { return static_cast<Derived&>(*this); }
+    const Derived& self() const { return static_cast<const Derived&>(*this); }
+  };
+
+  template<typename V, typename Pred>
+  struct FilterView
+  {
+    V base;
+    Pred pred;
+
+    using BaseIt = IteratorOf<V>;
+    struct iterator : IteratorBase<iterator, decltype(*std::declval<BaseIt>())>
+    {
+      BaseIt it, last;
+      const Pred* pred;
+      void skip() { while (it != last && !(*pred)(*it)) ++it; }
+      decltype(auto) operator*() const { return *it; }
+      void next() { ++it; skip(); }
+      bool equal(const iterator& other) const { return it == other.it; }
+    };
+
+    iterator begin() const
+    {
+      iterator i;
+      i.it = std::begin(base), i.last = std::end(base), i.pred = &pred;
+      i.skip();
+      return i;
+    }
+    iterator end() const
+    {
+      iterator i;
+      i.it = std::end(base), i.last = std::end(base), i.pred = &pred;
+      return i;
+    }
+  };
+
+  template<typename V, typename F>
+  struct TransformView
+  {
+    V base;
+    F f;
+
+    using BaseIt = IteratorOf<V>;
+    struct iterator : IteratorBase<iterator, decltype(std::declval<const F&>()(*std::declval<BaseIt>()))>
+    {
+      BaseIt it;
+      const F* f;
+      decltype(auto) operator*() const { return (*f)(*it); }
+      void next() { ++it; }
+      bool equal(const iterator& other) const { return it == other.it; }
+    };
+
+    iterator begin() const { iterator i; i.it = std::begin(base), i.f = &f; return i; }
+    iterator end() const { iterator i; i.it = std::end(base), i.f = &f; return i; }
+  };
+
+  template<typename V>
+  struct TakeView
+  {
+    V base;
+    std::size_t n;
+
+    using BaseIt = IteratorOf<V>;
+    struct iterator : IteratorBase<iterator, decltype(*std::declval<BaseIt>())>
+    {
+      BaseIt it;
+      std::size_t remaining;
+      decltype(auto) operator*() const { return *it; }
+      void next() { ++it; --remaining; }
+      // done after n elements or at the end of a shorter base
+      bool equal(const iterator& other) const { return remaining == other.remaining || it == other.it; }
+    };
+
+    iterator begin() const { iterator i; i.it = std::begin(base), i.remaining = n; return i; }
+    iterator end() const { iterator i; i.it = std::end(base), i.remaining = 0; return i; }
+  };
+
+  template<typename V>
+  struct ChunkView
+  {
+    V base;
+    std::size_t n;
+
+    using BaseIt = IteratorOf<V>;
+    struct iterator : IteratorBase<iterator, Subrange<BaseIt>>
+    {
+      BaseIt it, stop, last;
+      std::size_t n;
+      void seek() { stop = it; for (std::size_t k = 0; k < n && stop != last; ++k) ++stop; }
+      Subrange<BaseIt> operator*() const { return {it, stop}; }
+      void next() { it = stop; seek(); }
+      bool equal(const iterator& other) const { return it == other.it; }
+    };
+
+    iterator begin() const
+    {
+      iterator i;
+      i.it = std::begin(base), i.last = std::end(base), i.n = n;
+      i.seek();
+      return i;
+    }
+    iterator end() const
+    {
+      iterator i;
+      i.it = i.stop = i.last = std::end(base), i.n = n;
+      return i;
+    }
+  };
+
+  template<typename A, typename B>
+  struct ZipView
+  {
+    A a;
+    B b;
+
+    using ItA = IteratorOf<A>;
+    using ItB = IteratorOf<B>;
+    using Pair = std::pair<std::decay_t<decltype(*std::declval<ItA>())>,
+                           std::decay_t<decltype(*std::declval<ItB>())>>;
+    struct iterator : IteratorBase<iterator, Pair>
+    {
+      ItA ia;
+      ItB ib;
+      Pair operator*() const { return {*ia, *ib}; }
+      void next() { ++ia; ++ib; }
+      // ends with the shorter range
+      bool equal(const iterator& other) const { return ia == other.ia || ib == other.ib; }
+    };
+
+    iterator begin() const { iterator i; i.ia = std::begin(a), i.ib = std::begin(b); return i; }
+    iterator end() const { iterator i; i.ia = std::end(a), i.ib = std::end(b); return i; }
+  };
+
+  template<typename R, typename Pred>
+  auto filter(R&& r, Pred pred) { return FilterView<Stored<R>, Pred>{stored(std::forward<R>(r)), pred}; }
+
+  template<typename R, typename F>
+  auto transform(R&& r, F f) { return TransformView<Stored<R>, F>{stored(std::forward<R>(r)), f}; }
+
+  template<typename R>
+  auto take(R&& r, std::size_t n) { return TakeView<Stored<R>>{stored(std::forward<R>(r)), n}; }
+
+  // chunks of `n` > 0 elements, the last one may be shorter
+  template<typename R>
+  auto chunk(R&& r, std::size_t n)
+  {
+    if (n == 0) throw std::invalid_argument("chunk: size 0");
+    return ChunkView<Stored<R>>{stored(std::forward<R>(r)), n};
+  }
+
+  template<typename A, typename B>
+  auto zip(A&& a, B&& b)
+  {
+    return ZipView<Stored<A>, Stored<B>>{stored(std::forward<A>(a)), stored(std::forward<B>(b))};
+  }
+
+  // `range | adapter(args)` is `adapter(range, args)`
+  template<typename F>
+  struct Closure { F apply; };
+  template<typename F>
+  Closure(F) -> Closure<F>;
+
+  template<typename R, typename F>
+  auto operator|(R&& r, Closure<F> closure) { return closure.apply(std::forward<R>(r)); }
+
+  template<typename Pred>
+  auto filter(Pred pred) { return Closure{[pred](auto&& r) { return filter(std::forward<decltype(r)>(r), pred); }}; }
+
+  template<typename F>
+  auto transform(F f) { return Closure{[f](auto&& r) { return transform(std::forward<decltype(r)>(r), f); }}; }
+
+  inline auto take(std::size_t n) { return Closure{[n](auto&& r) { return take(std::forward<decltype(r)>(r), n); }}; }
+
+  inline auto chunk(std::size_t n)
+  {
+    if (n == 0) throw std::invalid_argument("chunk: size 0");
+    return Closure{[n](auto&& r) { return chunk(std::forward<decltype(r)>(r), n); }};
+  }
 }
 
 namespace Bridge
@@ -301,6 +581,24 @@ int main() {
     std::unique_ptr<World> world = std::make_unique<Apocalypse>();
     std::unique_ptr<World> anotherWorld = std::make_unique<Utopia>();
     CHECK("future", (world->futureBasedOn() !=  anotherWorld->futureBasedOn()));
+
+#ifdef HAS_COROUTINE
+    // ... and let every stage develop at the same time
+    Coroutine::ThreadPool pool(3);
+    CHECK_VALUE("future", Coroutine::sync_wait(world->futureBasedOnConcurrently(pool)),
+                world->futureBasedOn());
+
+    SlowUtopia slowWorld;
+    Harness::benchmark("futureBasedOn", [&] {
+      Harness::doNotOptimize(slowWorld.futureBasedOn());
+    });
+    Harness::benchmark(
+        "futureBasedOnConcurrently",
+        [&] { Harness::doNotOptimize(Coroutine::sync_wait(slowWorld.futureBasedOnConcurrently(pool))); },
+        true);
+#else
+    SKIPPED("futureBasedOnConcurrently", "needs -std=c++20 (make STD=c++20)");
+#endif
   }
 
   // AbstractFactory
@@ -361,6 +659,74 @@ int main() {
     CHECK_VALUE("Hohoho", &hisSanta, &herSanta);
   }
 
+  // Adapter
+  {
+    using namespace Adapter;
+    // the numbers of Algorithm::main, looked at through different adapters
+    const std::vector<int> numbers = {0, 2, 3, 1, 13, 5};
+    auto odd = [](int i) { return i % 2 != 0; };
+    auto tenfold = [](int i) { return i * 10; };
+
+    auto pipeline = numbers | filter(odd) | transform(tenfold) | take(3);
+    CHECK("pipeline", (std::vector<int>(pipeline.begin(), pipeline.end()) == std::vector<int>{30, 10, 130}));
+    CHECK_VALUE("index_of_max", index_of_max(pipeline), 2);
+    CHECK("all_equal", !all_equal(pipeline));
+    CHECK("all_equal", all_equal(numbers | transform([](int i) { return i * 0; })));
+    CHECK_VALUE("take", std::distance(take(numbers, 100).begin(), take(numbers, 100).end()), 6);
+
+    // chunks are ranges themselves
+    auto sums = numbers | chunk(4) | transform([](auto c) { return std::accumulate(c.begin(), c.end(), 0); });
+    CHECK("chunk", (std::vector<int>(sums.begin(), sums.end()) == std::vector<int>{6, 18}));
+    try
+    {
+      chunk(numbers, 0);
+      CHECK_FAILED("chunk(0)");
+    }
+    catch (const std::invalid_argument&) {}
+
+    // views of references are forward ranges, computed elements only input ranges
+    static_assert(std::is_same_v<std::iterator_traits<decltype(take(numbers, 2).begin())>::iterator_category,
+                                 std::forward_iterator_tag>);
+    static_assert(std::is_same_v<std::iterator_traits<decltype(pipeline.begin())>::iterator_category,
+                                 std::input_iterator_tag>);
+    static_assert(std::is_same_v<std::iterator_traits<decltype(sums.begin())>::iterator_category,
+                                 std::input_iterator_tag>);
+
+    // index_of_max and all_equal compute every element of a view once
+    int calls = 0;
+    auto counted = numbers | transform([&](int i) { return ++calls, i; });
+    CHECK_VALUE("index_of_max", index_of_max(counted), 4);
+    CHECK_VALUE("index_of_max", calls, 6);
+    calls = 0;
+    CHECK("all_equal", !all_equal(counted));
+    CHECK_VALUE("all_equal", calls, 2);  // stops at the first difference
+
+    const std::vector<int> another = {0, 2, 3, 4, 5, 6};
+    auto differs = zip(numbers, another) | transform([](auto p) { return p.first != p.second; });
+    CHECK_VALUE("zip", index_of_max(differs), 3);  // like std::mismatch
+
+    // a three-stage pipeline: lazy and fused vs materializing every step
+    std::vector<int> values(1 << 20);
+    std::mt19937 gen(42);
+    for (auto& v : values) v = static_cast<int>(gen() % 1000000);
+    auto notMultipleOf3 = [](int i) { return i % 3 != 0; };
+    auto scale = [](int i) { return i * 7 + 1; };
+    const std::size_t n = values.size() / 2;
+
+    auto materialized = [&] {
+      std::vector<int> filtered;
+      std::copy_if(values.begin(), values.end(), std::back_inserter(filtered), notMultipleOf3);
+      std::vector<int> transformed(filtered.size());
+      std::transform(filtered.begin(), filtered.end(), transformed.begin(), scale);
+      std::vector<int> taken(transformed.begin(), transformed.begin() + std::min(n, transformed.size()));
+      return index_of_max(taken);
+    };
+    auto fused = [&] { return index_of_max(values | filter(notMultipleOf3) | transform(scale) | take(n)); };
+    CHECK_VALUE("fused", fused(), materialized());
+    Harness::benchmark("materialize each step", [&] { Harness::doNotOptimize(materialized()); });
+    Harness::benchmark("fused pipeline", [&] { Harness::doNotOptimize(fused()); });
+  }
+
   // Bridge
   {
     using namespace Bridge;
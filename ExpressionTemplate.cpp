@@ -0,0 +1,342 @@
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Algorithm.h"
+#include "main.h"
+
+/*
+ * Expression templates for element-wise vector arithmetic.
+ *
+ * `a + b * c` does not compute anything, it returns a small object whose type
+ * is the expression tree `Binary<plus, Vector, Binary<multiplies, Vector, Vector>>`
+ * (like the nested template arguments of `Template::size_of`). Only assigning it
+ * to a `Vector` evaluates it, in one loop over all elements without any
+ * temporary vector. The loop body is the inlined tree, so the compiler can
+ * vectorize it.
+ *
+ * Expressions are ranges as well: `index_of_max(a + b * c)` of Algorithm.h
+ * or the reductions `sum` and `max` evaluate them lazily, without storing them.
+ *
+ * https://en.wikipedia.org/wiki/Expression_templates
+ */
+
+namespace ExpressionTemplate {
+
+template <typename E>
+class Iterator;
+
+/**
+ * CRTP base of all expressions, `E` provides `size()` and `operator[]`
+ */
+template <typename E>
+struct Expr {
+  const E& self() const { return static_cast<const E&>(*this); }
+
+  Iterator<E> begin() const { return {&self(), 0}; }
+  Iterator<E> end() const { return {&self(), self().size()}; }
+};
+
+// elements are computed on dereference, there is no reference to return,
+// which only makes an input iterator (like the views of DesignPattern::Adapter)
+template <typename E>
+class Iterator {
+ public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = std::decay_t<decltype(std::declval<const E&>()[0])>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = value_type;
+
+  Iterator() = default;
+  Iterator(const E* e, std::size_t i) : e(e), i(i) {}
+
+  value_type operator*() const { return (*e)[i]; }
+  Iterator& operator++() {
+    ++i;
+    return *this;
+  }
+  Iterator operator++(int) {
+    auto tmp = *this;
+    ++i;
+    return tmp;
+  }
+  bool operator==(const Iterator& other) const { return i == other.i; }
+  bool operator!=(const Iterator& other) const { return i != other.i; }
+
+ private:
+  const E* e = nullptr;
+  std::size_t i = 0;
+};
+
+template <typename T>
+class Vector : public Expr<Vector<T>> {
+ public:
+  Vector() = default;
+  explicit Vector(std::size_t n, T value = T()) : data(n, value) {}
+  Vector(std::initializer_list<T> values) : data(values) {}
+
+  // evaluate `e`, one fused loop
+  template <typename E>
+  Vector(const Expr<E>& e) : data(e.self().size()) {
+    assign(e.self());
+  }
+  template <typename E>
+  Vector& operator=(const Expr<E>& e) {
+    data.resize(e.self().size());
+    assign(e.self());
+    return *this;
+  }
+
+  std::size_t size() const { return data.size(); }
+  T operator[](std::size_t i) const { return data[i]; }
+  T& operator[](std::size_t i) { return data[i]; }
+
+  bool operator==(const Vector& other) const { return data == other.data; }
+
+ private:
+  // element `i` of the result only depends on element `i` of the operands,
+  // so `a = a + b` is fine
+  template <typename E>
+  void assign(const E& e) {
+    T* out = data.data();
+    const std::size_t n = data.size();
+    for (std::size_t i = 0; i < n; ++i) out[i] = e[i];
+  }
+
+  std::vector<T> data;
+};
+
+/**
+ * a number broadcast to every element, as in `2.0 * a`
+ */
+template <typename T>
+class Scalar : public Expr<Scalar<T>> {
+ public:
+  explicit Scalar(T value) : value(value) {}
+  std::size_t size() const { return 0; }  // fits any size
+  T operator[](std::size_t) const { return value; }
+
+ private:
+  T value;
+};
+
+template <typename E>
+constexpr bool is_scalar_v = false;
+template <typename T>
+constexpr bool is_scalar_v<Scalar<T>> = true;
+
+// vectors are held by reference, every other node is a small value
+template <typename E>
+struct stored {
+  using type = E;
+};
+template <typename T>
+struct stored<Vector<T>> {
+  using type = const Vector<T>&;
+};
+template <typename E>
+using stored_t = typename stored<E>::type;
+
+template <typename Op, typename E>
+class Unary : public Expr<Unary<Op, E>> {
+ public:
+  Unary(const E& e, Op op) : e(e), op(op) {}
+  std::size_t size() const { return e.size(); }
+  auto operator[](std::size_t i) const { return op(e[i]); }
+
+ private:
+  stored_t<E> e;
+  Op op;
+};
+
+template <typename Op, typename L, typename R>
+class Binary : public Expr<Binary<Op, L, R>> {
+ public:
+  // operands have the same size (or are scalars), else std::invalid_argument
+  Binary(const L& l, const R& r) : l(l), r(r) {
+    if (!is_scalar_v<L> && !is_scalar_v<R> && l.size() != r.size()) {
+      throw std::invalid_argument("ExpressionTemplate: operands differ in size");
+    }
+  }
+  std::size_t size() const { return l.size() > r.size() ? l.size() : r.size(); }
+  auto operator[](std::size_t i) const { return Op()(l[i], r[i]); }
+
+ private:
+  stored_t<L> l;
+  stored_t<R> r;
+};
+
+template <typename S>
+using if_scalar_t = std::enable_if_t<std::is_arithmetic_v<S>>;
+
+#define EXPRESSION_OPERATOR(op, Op)                                      \
+  template <typename L, typename R>                                      \
+  Binary<Op, L, R> operator op(const Expr<L>& l, const Expr<R>& r) {     \
+    return {l.self(), r.self()};                                         \
+  }                                                                      \
+  template <typename L, typename S, typename = if_scalar_t<S>>           \
+  Binary<Op, L, Scalar<S>> operator op(const Expr<L>& l, S s) {          \
+    return {l.self(), Scalar<S>(s)};                                     \
+  }                                                                      \
+  template <typename S, typename R, typename = if_scalar_t<S>>           \
+  Binary<Op, Scalar<S>, R> operator op(S s, const Expr<R>& r) {          \
+    return {Scalar<S>(s), r.self()};                                     \
+  }
+
+EXPRESSION_OPERATOR(+, std::plus<>)
+EXPRESSION_OPERATOR(-, std::minus<>)
+EXPRESSION_OPERATOR(*, std::multiplies<>)
+EXPRESSION_OPERATOR(/, std::divides<>)
+
+#undef EXPRESSION_OPERATOR
+
+template <typename E>
+Unary<std::negate<>, E> operator-(const Expr<E>& e) {
+  return {e.self(), std::negate<>()};
+}
+
+/**
+ * apply `f` to every element, e.g. `map(a - b, [](double x) { return std::abs(x); })`
+ */
+template <typename E, typename F>
+Unary<F, E> map(const Expr<E>& e, F f) {
+  return {e.self(), f};
+}
+
+template <typename E>
+auto sum(const Expr<E>& e) {
+  const auto& x = e.self();
+  decltype(x[0]) result{};
+  for (std::size_t i = 0; i < x.size(); ++i) result += x[i];
+  return result;
+}
+
+// of a non-empty expression
+template <typename E>
+auto max(const Expr<E>& e) {
+  return e.self()[index_of_max(e.self())];
+}
+
+/**
+ * naive operator overloading for comparison: every operator returns a new vector
+ */
+struct NaiveVector {
+  std::vector<double> data;
+};
+
+template <typename Op>
+NaiveVector zipWith(const NaiveVector& a, const NaiveVector& b, Op op) {
+  NaiveVector result{std::vector<double>(a.data.size())};
+  for (std::size_t i = 0; i < a.data.size(); ++i) result.data[i] = op(a.data[i], b.data[i]);
+  return result;
+}
+
+NaiveVector operator+(const NaiveVector& a, const NaiveVector& b) { return zipWith(a, b, std::plus<>()); }
+NaiveVector operator-(const NaiveVector& a, const NaiveVector& b) { return zipWith(a, b, std::minus<>()); }
+NaiveVector operator*(const NaiveVector& a, const NaiveVector& b) { return zipWith(a, b, std::multiplies<>()); }
+NaiveVector operator*(double s, const NaiveVector& b) {
+  NaiveVector result{b.data};
+  for (auto& x : result.data) x *= s;
+  return result;
+}
+
+//
+
+int main() {
+  const Vector<int> a = {0, 2, 3, 1};
+  const Vector<int> b = {1, 1, 1, 1};
+  const Vector<int> c = {5, 0, 2, 1};
+
+  // the type is the tree, nothing is computed yet
+  auto expr = a + b * c;
+  static_assert(std::is_same_v<decltype(expr),
+                               Binary<std::plus<>, Vector<int>,
+                                      Binary<std::multiplies<>, Vector<int>, Vector<int>>>>);
+  CHECK_VALUE("size", expr.size(), 4);
+  CHECK_VALUE("operator[]", expr[0], 5);
+
+  const Vector<int> r = expr;
+  CHECK("evaluate", (r == Vector<int>{5, 2, 5, 2}));
+  CHECK("scalar", (Vector<int>(2 * a - 1) == Vector<int>{-1, 3, 5, 1}));
+  CHECK("scalar", (Vector<int>(10 / (a + 1)) == Vector<int>{10, 3, 2, 5}));
+  CHECK("negate", (Vector<int>(-a) == Vector<int>{0, -2, -3, -1}));
+  CHECK("map", (Vector<int>(map(a - c, [](int x) { return x * x; })) == Vector<int>{25, 4, 1, 0}));
+
+  try {
+    (void)(a + Vector<int>{1, 2});
+    CHECK_FAILED("size mismatch");
+  } catch (const std::invalid_argument&) {
+  }
+  CHECK("empty", (Vector<int>(Vector<int>() * 2 + Vector<int>()) == Vector<int>()));
+
+  Vector<int> acc(4);
+  acc = acc + a;
+  acc = acc + a;  // aliasing the target is fine
+  CHECK("alias", (acc == Vector<int>{0, 4, 6, 2}));
+
+  // reductions and Algorithm.h evaluate the expression lazily
+  CHECK_VALUE("index_of_max", index_of_max(a * c), 2);
+  CHECK_VALUE("index_of_max", index_of_max(expr), 0);
+  CHECK_VALUE("max", max(a * c), 6);
+  CHECK_VALUE("sum", sum(a + b), 10);
+  CHECK("all_equal", all_equal(a * 0 + b));
+  static_assert(std::is_same_v<std::iterator_traits<decltype(expr.begin())>::iterator_category,
+                               std::input_iterator_tag>);
+  {
+    // both helpers of Algorithm.h evaluate every element once
+    int calls = 0;
+    auto counted = map(a, [&](int x) { return ++calls, x; });
+    CHECK("all_equal", !all_equal(counted));
+    CHECK_VALUE("all_equal", calls, 2);
+    calls = 0;
+    CHECK_VALUE("index_of_max", index_of_max(counted), 2);
+    CHECK_VALUE("index_of_max", calls, 4);
+  }
+
+  // benchmark against naive operators
+  constexpr std::size_t n = 1 << 20;
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  Vector<double> x(n), y(n), z(n), w(n);
+  NaiveVector nx{std::vector<double>(n)}, ny = nx, nz = nx, nw = nx;
+  for (std::size_t i = 0; i < n; ++i) {
+    nx.data[i] = x[i] = dist(gen);
+    ny.data[i] = y[i] = dist(gen);
+    nz.data[i] = z[i] = dist(gen);
+    nw.data[i] = w[i] = dist(gen);
+  }
+
+  Vector<double> result(n);
+  result = x + y * z - 2.0 * w;
+  NaiveVector naive = nx + ny * nz - 2.0 * nw;
+  bool same = true;
+  for (std::size_t i = 0; i < n; ++i) same &= result[i] == naive.data[i];
+  CHECK("naive", same);
+  CHECK_VALUE("naive", index_of_max(x + y * z), index_of_max((nx + ny * nz).data));
+
+  Harness::benchmark("naive x + y * z - 2 * w", [&] {
+    naive = nx + ny * nz - 2.0 * nw;
+    Harness::doNotOptimize(naive);
+  });
+  Harness::benchmark("expression x + y * z - 2 * w", [&] {
+    result = x + y * z - 2.0 * w;
+    Harness::doNotOptimize(result);
+  });
+  Harness::benchmark("naive index_of_max(x + y * z)", [&] {
+    Harness::doNotOptimize(index_of_max((nx + ny * nz).data));
+  });
+  Harness::benchmark("expression index_of_max(x + y * z)", [&] {
+    Harness::doNotOptimize(index_of_max(x + y * z));
+  });
+
+  return 0;
+}
+
+}  // namespace ExpressionTemplate
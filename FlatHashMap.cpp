@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "TupleHash.h"
+#include "main.h"
+
+/*
+ * Flat open-addressing hash map in the style of Swiss tables.
+ *
+ * - the key-value pairs live in one array, no allocation per node.
+ * - a parallel array of control bytes, one per slot: empty, deleted or, for a
+ *   full slot, 7 bits of the hash (H2).
+ * - slots are probed in groups of 16: one SSE2 compare of the 16 control bytes
+ *   against H2 yields a bit mask of candidates, the keys are compared only for
+ *   those. A group with an empty slot ends the search (no tombstone chains).
+ *   Without SSE2 the same masks are computed by a scalar loop.
+ * - the remaining bits of the hash (H1) select the first group, further groups
+ *   are probed quadratically.
+ *
+ * `TupleHash` (TupleHash.h) hashes tuples by a fold over their elements,
+ * strings as string views, so `std::tuple<std::string, int>` keys can be
+ * looked up by `std::tuple<std::string_view, int>` without constructing a
+ * string.
+ *
+ * https://abseil.io/about/design/swisstables
+ * https://www.youtube.com/watch?v=ncHmEUmJZf4 (CppCon 2017: Matt Kulukundis)
+ */
+
+namespace FlatHashMap {
+
+namespace detail {
+
+using Ctrl = std::int8_t;
+constexpr Ctrl kEmpty = -128;   // 0b10000000
+constexpr Ctrl kDeleted = -2;   // 0b11111110
+constexpr std::size_t kGroup = 16;
+
+inline bool isFull(Ctrl c) { return c >= 0; }
+
+/**
+ * matches of 16 control bytes as bit mask
+ */
+struct Group {
+  explicit Group(const Ctrl* ctrl) : ctrl(ctrl) {}
+
+#if defined(__SSE2__)
+  std::uint32_t match(Ctrl h2) const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(load(), _mm_set1_epi8(h2)));
+  }
+  std::uint32_t matchEmpty() const { return match(kEmpty); }
+  // empty and deleted have the sign bit set
+  std::uint32_t matchFree() const { return _mm_movemask_epi8(load()); }
+
+ private:
+  __m128i load() const { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl)); }
+#else
+  std::uint32_t match(Ctrl h2) const {
+    std::uint32_t mask = 0;
+    for (std::size_t i = 0; i < kGroup; ++i) mask |= std::uint32_t(ctrl[i] == h2) << i;
+    return mask;
+  }
+  std::uint32_t matchEmpty() const { return match(kEmpty); }
+  std::uint32_t matchFree() const {
+    std::uint32_t mask = 0;
+    for (std::size_t i = 0; i < kGroup; ++i) mask |= std::uint32_t(ctrl[i] < 0) << i;
+    return mask;
+  }
+
+ private:
+#endif
+  const Ctrl* ctrl;
+};
+
+inline unsigned lowestBit(std::uint32_t mask) { return __builtin_ctz(mask); }
+
+}  // namespace detail
+
+template <typename K, typename V, typename Hash = TupleHash, typename Eq = std::equal_to<>>
+class FlatHashMap {
+ public:
+  using value_type = std::pair<const K, V>;
+
+  FlatHashMap() = default;
+  ~FlatHashMap() { destroy(); }
+  FlatHashMap(FlatHashMap&& other) noexcept { swap(other); }
+  FlatHashMap& operator=(FlatHashMap&& other) noexcept {
+    FlatHashMap(std::move(other)).swap(*this);
+    return *this;
+  }
+  FlatHashMap(const FlatHashMap&) = delete;
+  FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+  template <typename P>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = FlatHashMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = P*;
+    using reference = P&;
+
+    Iterator() = default;
+    Iterator(const detail::Ctrl* ctrl, P* slot, P* end) : ctrl(ctrl), slot(slot), end(end) { skip(); }
+
+    reference operator*() const { return *slot; }
+    pointer operator->() const { return slot; }
+    Iterator& operator++() {
+      ++ctrl, ++slot;
+      skip();
+      return *this;
+    }
+    Iterator operator++(int) {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+    }
+    bool operator==(const Iterator& other) const { return slot == other.slot; }
+    bool operator!=(const Iterator& other) const { return slot != other.slot; }
+
+   private:
+    void skip() {
+      while (slot != end && !detail::isFull(*ctrl)) ++ctrl, ++slot;
+    }
+
+    const detail::Ctrl* ctrl = nullptr;
+    P* slot = nullptr;
+    P* end = nullptr;
+  };
+  using iterator = Iterator<value_type>;
+  using const_iterator = Iterator<const value_type>;
+
+  iterator begin() { return {ctrl.get(), slots, slots + slotCount}; }
+  iterator end() { return {nullptr, slots + slotCount, slots + slotCount}; }
+  const_iterator begin() const { return {ctrl.get(), slots, slots + slotCount}; }
+  const_iterator end() const { return {nullptr, slots + slotCount, slots + slotCount}; }
+
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  std::size_t capacity() const { return slotCount; }
+
+  /**
+   * `key` may be of any type `Hash` and `Eq` accept, e.g. a tuple of views
+   */
+  template <typename Q>
+  iterator find(const Q& key) {
+    const auto i = lookup(key);
+    return i == kNotFound ? end() : iteratorAt(i);
+  }
+  template <typename Q>
+  const_iterator find(const Q& key) const {
+    const auto i = lookup(key);
+    return i == kNotFound ? end() : const_iterator(ctrl.get() + i, slots + i, slots + slotCount);
+  }
+  template <typename Q>
+  bool contains(const Q& key) const {
+    return lookup(key) != kNotFound;
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+    return emplace(key, std::forward<Args>(args)...);
+  }
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+    return emplace(std::move(key), std::forward<Args>(args)...);
+  }
+  std::pair<iterator, bool> insert(std::pair<K, V> value) {
+    return emplace(std::move(value.first), std::move(value.second));
+  }
+  V& operator[](const K& key) { return try_emplace(key).first->second; }
+  V& operator[](K&& key) { return try_emplace(std::move(key)).first->second; }
+
+  template <typename Q>
+  bool erase(const Q& key) {
+    const auto i = lookup(key);
+    if (i == kNotFound) return false;
+    slots[i].~value_type();
+    // a probe never went past a group with an empty slot, so no tombstone needed
+    const std::size_t group = i & ~(detail::kGroup - 1);
+    if (detail::Group(ctrl.get() + group).matchEmpty()) {
+      ctrl[i] = detail::kEmpty;
+    } else {
+      ctrl[i] = detail::kDeleted;
+      ++deleted;
+    }
+    --count;
+    return true;
+  }
+
+  void clear() { destroy(); }
+
+  // room for `n` elements without rehashing
+  void reserve(std::size_t n) {
+    if (n > growthLimit()) rehash(n);
+  }
+
+  /**
+   * rebuild with room for at least max(n, size()) elements, drops tombstones
+   */
+  void rehash(std::size_t n) {
+    n = std::max(n, count);
+    std::size_t groups = 1;
+    while (groups * detail::kGroup * 7 / 8 < n) groups *= 2;
+    FlatHashMap next;
+    next.allocate(groups * detail::kGroup);
+    for (std::size_t i = 0; i < slotCount; ++i) {
+      if (!detail::isFull(ctrl[i])) continue;
+      auto& slot = slots[i];
+      const auto h = hash(slot.first);
+      const auto j = next.freeSlot(h);
+      next.ctrl[j] = h2(h);
+      new (next.slots + j) value_type(std::move(const_cast<K&>(slot.first)), std::move(slot.second));
+      ++next.count;
+    }
+    next.swap(*this);
+  }
+
+  void swap(FlatHashMap& other) noexcept {
+    std::swap(ctrl, other.ctrl);
+    std::swap(slots, other.slots);
+    std::swap(slotCount, other.slotCount);
+    std::swap(count, other.count);
+    std::swap(deleted, other.deleted);
+  }
+
+ private:
+  static constexpr std::size_t kNotFound = ~std::size_t(0);
+
+  template <typename Q>
+  static std::size_t hash(const Q& key) {
+    return Hash()(key);
+  }
+  static detail::Ctrl h2(std::size_t h) { return static_cast<detail::Ctrl>(h & 0x7F); }
+
+  std::size_t groupMask() const { return slotCount / detail::kGroup - 1; }
+  std::size_t growthLimit() const { return slotCount * 7 / 8; }
+
+  // index of the slot holding `key` or kNotFound
+  template <typename Q>
+  std::size_t lookup(const Q& key) const {
+    if (count == 0) return kNotFound;
+    const auto h = hash(key);
+    const auto tag = h2(h);
+    std::size_t group = (h >> 7) & groupMask();
+    for (std::size_t probe = 1;; ++probe) {
+      const std::size_t base = group * detail::kGroup;
+      const detail::Group g(ctrl.get() + base);
+      for (auto mask = g.match(tag); mask; mask &= mask - 1) {
+        const std::size_t i = base + detail::lowestBit(mask);
+        if (Eq()(slots[i].first, key)) return i;
+      }
+      if (g.matchEmpty()) return kNotFound;
+      group = (group + probe) & groupMask();  // triangular numbers visit every group
+    }
+  }
+
+  // first empty or deleted slot of the probe sequence of `h`, there is one
+  std::size_t freeSlot(std::size_t h) const {
+    std::size_t group = (h >> 7) & groupMask();
+    for (std::size_t probe = 1;; ++probe) {
+      const std::size_t base = group * detail::kGroup;
+      if (const auto mask = detail::Group(ctrl.get() + base).matchFree()) {
+        return base + detail::lowestBit(mask);
+      }
+      group = (group + probe) & groupMask();
+    }
+  }
+
+  template <typename Key, typename... Args>
+  std::pair<iterator, bool> emplace(Key&& key, Args&&... args) {
+    const auto found = lookup(key);
+    if (found != kNotFound) return {iteratorAt(found), false};
+    if (count + deleted + 1 > growthLimit()) {
+      // mostly tombstones: clean up in place, otherwise grow
+      rehash(count + 1 > growthLimit() / 2 ? slotCount : count + 1);
+    }
+    const auto h = hash(key);
+    const auto i = freeSlot(h);
+    new (slots + i) value_type(std::piecewise_construct, std::forward_as_tuple(std::forward<Key>(key)),
+                               std::forward_as_tuple(std::forward<Args>(args)...));
+    if (ctrl[i] == detail::kDeleted) --deleted;
+    ctrl[i] = h2(h);
+    ++count;
+    return {iteratorAt(i), true};
+  }
+
+  iterator iteratorAt(std::size_t i) { return {ctrl.get() + i, slots + i, slots + slotCount}; }
+
+  void allocate(std::size_t n) {
+    ctrl.reset(new detail::Ctrl[n]);
+    std::memset(ctrl.get(), detail::kEmpty, n);
+    slots = std::allocator<value_type>().allocate(n);
+    slotCount = n;
+  }
+
+  void destroy() {
+    for (std::size_t i = 0; i < slotCount; ++i) {
+      if (detail::isFull(ctrl[i])) slots[i].~value_type();
+    }
+    if (slots) std::allocator<value_type>().deallocate(slots, slotCount);
+    ctrl.reset();
+    slots = nullptr;
+    slotCount = count = deleted = 0;
+  }
+
+  std::unique_ptr<detail::Ctrl[]> ctrl;
+  value_type* slots = nullptr;  // raw storage, constructed where ctrl is full
+  std::size_t slotCount = 0;    // multiple of kGroup, power of 2
+  std::size_t count = 0;
+  std::size_t deleted = 0;
+};
+
+//
+
+using Key = std::tuple<std::string, int>;
+
+int main() {
+  FlatHashMap<Key, double> map;
+  CHECK("empty", map.empty());
+  CHECK("find", (map.find(Key("Apple", 1)) == map.end()));
+
+  // the tuple of Tuple::main, more or less
+  map[Key("Apple", 1)] = 2.0;
+  map.try_emplace(Key("Kiwi", 3), 4.0);
+  CHECK("try_emplace", !map.try_emplace(Key("Kiwi", 3), 5.0).second);
+  CHECK("insert", map.insert({Key("Fig", 5), 6.0}).second);
+  CHECK_VALUE("size", map.size(), 3);
+  CHECK_VALUE("find", map.find(Key("Kiwi", 3))->second, 4.0);
+  CHECK("contains", !map.contains(Key("Kiwi", 4)));
+
+  // heterogeneous lookup, no std::string constructed
+  const std::string_view apple = "Apple";
+  CHECK_VALUE("view", TupleHash()(std::make_tuple(apple, 1)), TupleHash()(Key("Apple", 1)));
+  CHECK_VALUE("view", map.find(std::make_tuple(apple, 1))->second, 2.0);
+  CHECK("view", !map.contains(std::make_tuple(apple, 2)));
+
+  CHECK("erase", map.erase(std::make_tuple(apple, 1)));
+  CHECK("erase", !map.erase(std::make_tuple(apple, 1)));
+  CHECK_VALUE("erase", map.size(), 2);
+
+  // growth, tombstones and rehash against std::unordered_map
+  {
+    FlatHashMap<std::tuple<int, int>, int> flat;
+    std::unordered_map<std::tuple<int, int>, int, TupleHash> reference;
+    std::mt19937 gen(42);
+    for (int i = 0; i < 200000; ++i) {
+      const auto key = std::make_tuple(int(gen() % 5000), int(gen() % 7));
+      if (gen() % 3 == 0) {
+        if (flat.erase(key) != (reference.erase(key) != 0)) CHECK_FAILED("erase");
+      } else {
+        flat[key] += i;
+        reference[key] += i;
+      }
+    }
+    CHECK_VALUE("size", flat.size(), reference.size());
+    std::size_t same = 0;
+    for (const auto& [key, value] : flat) same += reference.count(key) && reference.at(key) == value;
+    CHECK_VALUE("content", same, reference.size());
+
+    const auto before = flat.capacity();
+    flat.reserve(100000);
+    CHECK("reserve", (flat.capacity() >= 100000 && flat.capacity() > before));
+    CHECK_VALUE("reserve", flat.size(), reference.size());
+    flat.rehash(0);
+    CHECK("rehash", (flat.capacity() < before * 2 && flat.size() == reference.size()));
+    for (const auto& [key, value] : reference) {
+      if (flat.find(key) == flat.end() || flat.find(key)->second != value) CHECK_FAILED("rehash");
+    }
+    flat.clear();
+    CHECK("clear", (flat.empty() && flat.begin() == flat.end()));
+  }
+
+  // benchmark against std::unordered_map with the same hash
+  using IntKey = std::tuple<int, int>;
+  constexpr int n = 1 << 18;
+  std::vector<IntKey> keys, misses;
+  std::mt19937 gen(7);
+  for (int i = 0; i < n; ++i) keys.emplace_back(int(gen()), i);
+  for (int i = 0; i < n; ++i) misses.emplace_back(int(gen()), -i - 1);
+  std::shuffle(misses.begin(), misses.end(), gen);
+
+  Harness::benchmark("std::unordered_map insert", [&] {
+    std::unordered_map<IntKey, int, TupleHash> m;
+    for (int i = 0; i < n; ++i) m.emplace(keys[i], i);
+    Harness::doNotOptimize(m);
+  });
+  Harness::benchmark("FlatHashMap insert", [&] {
+    FlatHashMap<IntKey, int> m;
+    for (int i = 0; i < n; ++i) m.try_emplace(keys[i], i);
+    Harness::doNotOptimize(m);
+  });
+
+  std::unordered_map<IntKey, int, TupleHash> node;
+  FlatHashMap<IntKey, int> flat;
+  for (int i = 0; i < n; ++i) node.emplace(keys[i], i), flat.try_emplace(keys[i], i);
+  auto hits = keys;
+  std::shuffle(hits.begin(), hits.end(), gen);
+  auto lookup = [](const auto& m, const std::vector<IntKey>& queries) {
+    long sum = 0;
+    for (const auto& q : queries) {
+      const auto found = m.find(q);
+      sum += found == m.end() ? 1 : found->second;
+    }
+    return sum;
+  };
+  CHECK_VALUE("hit", lookup(flat, hits), lookup(node, hits));
+  CHECK_VALUE("miss", lookup(flat, misses), n);
+  Harness::benchmark("std::unordered_map hit", [&] { Harness::doNotOptimize(lookup(node, hits)); });
+  Harness::benchmark("FlatHashMap hit", [&] { Harness::doNotOptimize(lookup(flat, hits)); });
+  Harness::benchmark("std::unordered_map miss", [&] { Harness::doNotOptimize(lookup(node, misses)); });
+  Harness::benchmark("FlatHashMap miss", [&] { Harness::doNotOptimize(lookup(flat, misses)); });
+
+  return 0;
+}
+
+}  // namespace FlatHashMap
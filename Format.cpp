@@ -0,0 +1,151 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Format.h"
+#include "main.h"
+
+/*
+ * Allocation-free formatting, see Format.h.
+ *
+ * `std::to_string` allocates a string per number (beyond the small string
+ * buffer), `ostream<<` goes through locale facets and virtual calls.
+ * Format::toChars writes straight into a caller buffer: integers two digits per
+ * division from a table, floating point in the shortest form that reads back
+ * as the same value. CHECK_VALUE, RUN_TEST and the [perf] lines of the harness
+ * use it.
+ *
+ * https://www.zverovich.net/2013/09/07/integer-to-string-conversion-in-cplusplus.html
+ * https://en.cppreference.com/w/cpp/utility/to_chars
+ */
+
+namespace Format {
+
+std::string str(std::int64_t value) {
+  char buffer[kMaxInteger];
+  return std::string(buffer, toChars(buffer, value));
+}
+
+//
+
+int main() {
+  // integers, against std::to_string
+  CHECK_VALUE("0", str(0), "0");
+  CHECK_VALUE("9", str(9), "9");
+  CHECK_VALUE("10", str(10), "10");
+  CHECK_VALUE("-1", str(-1), "-1");
+  CHECK_VALUE("min", str(std::numeric_limits<std::int64_t>::min()), "-9223372036854775808");
+  {
+    char buffer[kMaxInteger];
+    const auto max = std::numeric_limits<std::uint64_t>::max();
+    CHECK_VALUE("max", std::string(buffer, toChars(buffer, max)), "18446744073709551615");
+  }
+  std::mt19937_64 gen(42);
+  std::vector<std::int64_t> integers;
+  for (int i = 0; i < 1 << 16; ++i) {
+    // every magnitude, not only huge numbers
+    integers.push_back(static_cast<std::int64_t>(gen()) >> (gen() % 64));
+  }
+  for (auto i : integers) {
+    if (str(i) != std::to_string(i)) CHECK_FAILED("to_string");
+  }
+
+  // shortest round-trip floating point
+  auto shortest = [](double value) {
+    char buffer[kMaxFloat];
+    return std::string(buffer, toChars(buffer, value));
+  };
+  CHECK_VALUE("0.1", shortest(0.1), "0.1");
+  CHECK_VALUE("0.3", shortest(0.1 + 0.2), "0.30000000000000004");
+  CHECK_VALUE("123.456", shortest(123.456), "123.456");
+  CHECK_VALUE("-2", shortest(-2.0), "-2");
+  std::vector<double> doubles;
+  for (int i = 0; i < 1 << 16; ++i) {
+    doubles.push_back(std::ldexp(double(gen()) / double(gen.max()), int(gen() % 200) - 100));
+  }
+  for (auto d : doubles) {
+    if (std::strtod(shortest(d).c_str(), nullptr) != d) CHECK_FAILED("round-trip");
+  }
+
+  // the writer
+  {
+    Buffer<32> line;
+    line << "Apple " << 1 << ' ' << 2.5 << ' ' << true << ' ' << std::string("Kiwi");
+    CHECK_VALUE("Writer", line.view(), "Apple 1 2.5 true Kiwi");
+    CHECK("Writer", !line.truncated());
+    line << " and a lot more than fits";
+    CHECK_VALUE("truncated", line.size(), 32);
+    CHECK("truncated", line.truncated());
+    line.clear();
+    line.fixed(3.14159, 3) << ' ';
+    line.fixed(-0.26, 1) << ' ';
+    line.fixed(2.0, 0);
+    CHECK_VALUE("fixed", line.view(), "3.142 -0.3 2");
+
+    // only plain char is a character
+    line.clear();
+    line << 'A' << ' ' << std::int8_t(65) << ' ' << std::uint8_t(200) << ' ' << std::int8_t(-1);
+    CHECK_VALUE("bytes", line.view(), "A 65 200 -1");
+  }
+
+  // benchmarks against std::to_string and ostream
+  std::vector<char> out(integers.size() * (kMaxInteger + 1));
+  Harness::benchmark("std::to_string integers", [&] {
+    std::size_t size = 0;
+    for (auto i : integers) size += std::to_string(i).size();
+    Harness::doNotOptimize(size);
+  });
+  Harness::benchmark("ostream integers", [&] {
+    std::ostringstream os;
+    for (auto i : integers) os << i << ' ';
+    Harness::doNotOptimize(os);
+  });
+  Harness::benchmark("Format::toChars integers", [&] {
+    char* p = out.data();
+    for (auto i : integers) *(p = toChars(p, i))++ = ' ';
+    Harness::doNotOptimize(p);
+  });
+
+  Harness::benchmark("ostream doubles (round-trip)", [&] {
+    std::ostringstream os;
+    os << std::setprecision(17);
+    for (auto d : doubles) os << d << ' ';
+    Harness::doNotOptimize(os);
+  });
+  std::vector<char> outDoubles(doubles.size() * (kMaxFloat + 1));
+  Harness::benchmark("Format::toChars doubles", [&] {
+    char* p = outDoubles.data();
+    for (auto d : doubles) *(p = toChars(p, d))++ = ' ';
+    Harness::doNotOptimize(p);
+  });
+
+  // a log line as CHECK_VALUE writes it
+  Harness::benchmark("ostream log lines", [&] {
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < integers.size(); ++i) {
+      std::ostringstream os;
+      os << "[FAILED] [" << "value" << "] expected: " << integers[i] << ", actual: " << i << '\n';
+      size += os.tellp();
+    }
+    Harness::doNotOptimize(size);
+  });
+  Harness::benchmark("Format::Writer log lines", [&] {
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < integers.size(); ++i) {
+      Buffer<128> line;
+      line << "[FAILED] [" << "value" << "] expected: " << integers[i] << ", actual: " << i << '\n';
+      size += line.size();
+    }
+    Harness::doNotOptimize(size);
+  });
+
+  return 0;
+}
+
+}  // namespace Format
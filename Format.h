@@ -0,0 +1,231 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string_view>
+#include <type_traits>
+
+/*
+ * allocation-free formatting into a caller provided buffer, see Format.cpp
+ *
+ * - integers: two digits at a time from a table of the 100 digit pairs
+ * - floating point: the shortest string which reads back as the same value
+ *   (std::to_chars where the library has it, else the smallest `%.*g` that
+ *   round-trips)
+ * - `Writer`: formats a sequence of values into a buffer, truncating when it
+ *   is full; `Buffer<N>` is a writer with its own storage on the stack
+ */
+
+namespace Format {
+
+// enough for any 64 bit integer with sign
+constexpr std::size_t kMaxInteger = 20;
+// enough for the shortest form of any double, e.g. -2.2250738585072014e-308
+constexpr std::size_t kMaxFloat = 32;
+
+namespace detail {
+
+inline constexpr char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+inline unsigned digits10(std::uint64_t v) {
+  unsigned n = 1;
+  for (;;) {
+    if (v < 10) return n;
+    if (v < 100) return n + 1;
+    if (v < 1000) return n + 2;
+    if (v < 10000) return n + 3;
+    v /= 10000;
+    n += 4;
+  }
+}
+
+inline char* formatUnsigned(char* out, std::uint64_t v) {
+  const unsigned n = digits10(v);
+  char* p = out + n;
+  while (v >= 100) {
+    const auto pair = (v % 100) * 2;
+    v /= 100;
+    p -= 2;
+    std::memcpy(p, kDigitPairs + pair, 2);
+  }
+  if (v >= 10) {
+    std::memcpy(p - 2, kDigitPairs + v * 2, 2);
+  } else {
+    p[-1] = static_cast<char>('0' + v);
+  }
+  return out + n;
+}
+
+}  // namespace detail
+
+/**
+ * write `value` to `out` (at least kMaxInteger bytes), return the end
+ */
+template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+char* toChars(char* out, T value) {
+  if constexpr (std::is_signed_v<T>) {
+    if (value < 0) {
+      *out++ = '-';
+      return detail::formatUnsigned(out, std::uint64_t(0) - static_cast<std::uint64_t>(value));
+    }
+  }
+  return detail::formatUnsigned(out, static_cast<std::uint64_t>(value));
+}
+
+/**
+ * shortest round-trip form of `value` to `out` (at least kMaxFloat bytes),
+ * return the end
+ */
+template <typename T, typename = std::enable_if_t<std::is_floating_point_v<T>>, typename = void>
+char* toChars(char* out, T value) {
+#if defined(__cpp_lib_to_chars)
+  return std::to_chars(out, out + kMaxFloat, value).ptr;
+#else
+  constexpr int kMaxPrecision = std::numeric_limits<T>::max_digits10;
+  int n = 0;
+  for (int precision = 1; precision <= kMaxPrecision; ++precision) {
+    if constexpr (std::is_same_v<T, long double>) {
+      n = std::snprintf(out, kMaxFloat, "%.*Lg", precision, value);
+      if (std::strtold(out, nullptr) == value) break;
+    } else {
+      n = std::snprintf(out, kMaxFloat, "%.*g", precision, static_cast<double>(value));
+      if ((std::is_same_v<T, float> ? std::strtof(out, nullptr) : std::strtod(out, nullptr)) == value) break;
+    }
+  }
+  return out + n;
+#endif
+}
+
+/**
+ * formats into `[buffer, buffer + capacity)`, what does not fit is dropped
+ */
+class Writer {
+ public:
+  Writer(char* buffer, std::size_t capacity) : first(buffer), cur(buffer), last(buffer + capacity) {}
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  std::string_view view() const { return std::string_view(first, cur - first); }
+  const char* data() const { return first; }
+  std::size_t size() const { return cur - first; }
+  bool truncated() const { return overflow; }
+  void clear() {
+    cur = first;
+    overflow = false;
+  }
+
+  Writer& append(const char* s, std::size_t n) {
+    const std::size_t room = last - cur;
+    if (n > room) {
+      n = room;
+      overflow = true;
+    }
+    std::memcpy(cur, s, n);
+    cur += n;
+    return *this;
+  }
+
+  /**
+   * integers, floating point (shortest round-trip), bool as true/false, char,
+   * anything convertible to std::string_view. other types go through their
+   * ostream operator<< (which allocates).
+   * unlike ostream, signed char and unsigned char (int8_t, uint8_t) print as
+   * numbers: they hold bytes and small counts here, not text.
+   */
+  template <typename T>
+  Writer& operator<<(const T& value) {
+    if constexpr (std::is_same_v<T, bool>) {
+      return value ? append("true", 4) : append("false", 5);
+    } else if constexpr (std::is_same_v<T, char>) {
+      return append(&value, 1);
+    } else if constexpr (std::is_integral_v<T>) {
+      return put<kMaxInteger>([&](char* out) { return toChars(out, value); });
+    } else if constexpr (std::is_floating_point_v<T>) {
+      return put<kMaxFloat>([&](char* out) { return toChars(out, value); });
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+      const std::string_view s = value;
+      return append(s.data(), s.size());
+    } else {
+      std::ostringstream os;
+      os << value;
+      const auto s = os.str();
+      return append(s.data(), s.size());
+    }
+  }
+
+  /**
+   * `value` with `decimals` digits after the point, like printf("%.*f")
+   */
+  Writer& fixed(double value, int decimals) {
+    double scale = 1;
+    for (int i = 0; i < decimals; ++i) scale *= 10;
+    if (decimals > 18 || !(std::fabs(value) * scale < 9e18)) {  // also NaN
+      char tmp[kMaxFloat + 320];
+      const int n = std::snprintf(tmp, sizeof(tmp), "%.*f", decimals, value);
+      return append(tmp, n < int(sizeof(tmp)) ? n : sizeof(tmp) - 1);
+    }
+    auto scaled = std::llround(value * scale);
+    if (scaled < 0) {
+      *this << '-';
+      scaled = -scaled;
+    }
+    const auto divisor = static_cast<long long>(scale);
+    *this << scaled / divisor;
+    if (decimals > 0) {
+      char digits[kMaxInteger];
+      auto frac = scaled % divisor;
+      for (int i = decimals - 1; i >= 0; --i, frac /= 10) digits[i] = static_cast<char>('0' + frac % 10);
+      *this << '.';
+      append(digits, decimals);
+    }
+    return *this;
+  }
+
+ private:
+  // format straight into the buffer if `N` bytes fit, else via a temporary
+  template <std::size_t N, typename F>
+  Writer& put(F format) {
+    if (static_cast<std::size_t>(last - cur) >= N) {
+      cur = format(cur);
+      return *this;
+    }
+    char tmp[N];
+    return append(tmp, format(tmp) - tmp);
+  }
+
+  char* first;
+  char* cur;
+  char* last;
+  bool overflow = false;
+};
+
+/**
+ * writer with `N` bytes of its own
+ */
+template <std::size_t N>
+class Buffer : public Writer {
+ public:
+  Buffer() : Writer(storage, N) {}
+
+ private:
+  char storage[N];
+};
+
+/**
+ * write and flush, e.g. to stdout or stderr
+ */
+inline void print(std::FILE* file, const Writer& writer) {
+  std::fwrite(writer.data(), 1, writer.size(), file);
+  std::fflush(file);
+}
+
+}  // namespace Format
@@ -1,6 +1,7 @@
 #include <functional>
 #include <tuple>
 
+#include "FunctionPointer.h"
 #include "main.h"
 /*
  *
@@ -13,7 +14,7 @@
 namespace FunctionPointer {
 
 // free function
-int func(std::string, double d = 3.21) { return d * 100; }
+int func(std::string, double d) { return d * 100; }
 
 // member function
 struct Klass {
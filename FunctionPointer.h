@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+/*
+ * the free function of FunctionPointer.cpp, for other examples to call or
+ * wrap (e.g. Memoize)
+ */
+
+namespace FunctionPointer {
+
+int func(std::string, double d = 3.21);
+
+}  // namespace FunctionPointer
@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "main.h"
+
+/*
+ * Name to callable registry with lock-free reads.
+ *
+ * The handlers live in an immutable snapshot which is replaced as a whole by
+ * writers (read-copy-update). Readers only announce the current epoch in their
+ * own slot and load the snapshot pointer, they never take a lock or touch a
+ * shared reference count. A replaced snapshot is reclaimed once no reader
+ * announced an epoch older than its replacement (epoch based reclamation).
+ *
+ * https://www.kernel.org/doc/html/latest/RCU/whatisRCU.html
+ * https://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf (epoch based reclamation)
+ */
+
+namespace FunctionRegistry {
+
+/**
+ * process wide epoch based reclamation
+ */
+class EpochDomain {
+ public:
+  static EpochDomain& instance() {
+    static EpochDomain domain;
+    return domain;
+  }
+
+ private:
+  struct ThreadState;
+
+ public:
+  /**
+   * RAII read-side critical section, may be nested
+   */
+  class ReadGuard {
+   public:
+    ReadGuard() : local(threadState()) {
+      if (local.depth++ == 0) {
+        auto& domain = instance();
+        // seq_cst: the announcement is ordered before the following loads
+        local.slot->epoch.store(domain.global.load(std::memory_order_seq_cst),
+                                std::memory_order_seq_cst);
+      }
+    }
+    ~ReadGuard() {
+      if (--local.depth == 0) {
+        local.slot->epoch.store(kQuiescent, std::memory_order_release);
+      }
+    }
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+   private:
+    ThreadState& local;
+  };
+
+  /**
+   * free `p` with `deleter` once all readers which might still see it are gone.
+   * must be called after `p` was unpublished.
+   */
+  void retire(void* p, void (*deleter)(void*)) {
+    const auto epoch = global.fetch_add(1, std::memory_order_seq_cst) + 1;
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    retired.push_back({p, deleter, epoch});
+    reclaim(oldestActive());
+  }
+
+  /**
+   * wait until everything retired so far is reclaimed
+   */
+  void synchronize() {
+    const auto epoch = global.fetch_add(1, std::memory_order_seq_cst) + 1;
+    while (oldestActive() < epoch) std::this_thread::yield();
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    reclaim(epoch);
+  }
+
+ private:
+  static constexpr std::uint64_t kQuiescent = ~std::uint64_t(0);
+  static constexpr std::size_t kBlockSlots = 64;
+
+  struct alignas(64) Slot {
+    std::atomic<std::uint64_t> epoch{kQuiescent};
+    std::atomic<bool> used{false};
+  };
+
+  // reader slots grow by a block whenever all are taken. blocks are never
+  // freed: a thread may still release its slot while the process exits.
+  struct Block {
+    Slot slots[kBlockSlots];
+    std::atomic<Block*> next{nullptr};
+  };
+
+  struct Retired {
+    void* p;
+    void (*deleter)(void*);
+    std::uint64_t epoch;  // safe to free once every reader is at or past it
+  };
+
+  EpochDomain() = default;
+
+  // reader slot and nesting depth of the calling thread
+  struct ThreadState {
+    Slot* slot = nullptr;
+    int depth = 0;
+    ~ThreadState() {
+      if (slot) slot->used.store(false, std::memory_order_release);
+    }
+  };
+
+  static ThreadState& threadState() {
+    thread_local ThreadState state;
+    if (!state.slot) state.slot = instance().acquireSlot();
+    return state;
+  }
+
+  Slot* acquireSlot() {
+    for (Block* block = &head;;) {
+      for (auto& slot : block->slots) {
+        bool expected = false;
+        if (!slot.used.load(std::memory_order_relaxed) &&
+            slot.used.compare_exchange_strong(expected, true)) {
+          return &slot;
+        }
+      }
+      Block* next = block->next.load(std::memory_order_seq_cst);
+      if (!next) {
+        // all taken, append a block (or use the one another thread appended).
+        // seq_cst: a reclaimer which does not see the block yet is ordered
+        // before the epoch announcement in it
+        auto* fresh = new Block;
+        if (block->next.compare_exchange_strong(next, fresh, std::memory_order_seq_cst)) {
+          next = fresh;
+        } else {
+          delete fresh;
+        }
+      }
+      block = next;
+    }
+  }
+
+  std::uint64_t oldestActive() const {
+    std::uint64_t oldest = kQuiescent;
+    for (const Block* block = &head; block; block = block->next.load(std::memory_order_seq_cst)) {
+      for (const auto& slot : block->slots) {
+        oldest = std::min(oldest, slot.epoch.load(std::memory_order_seq_cst));
+      }
+    }
+    return oldest;
+  }
+
+  // requires `retiredMutex`
+  void reclaim(std::uint64_t oldest) {
+    std::size_t kept = 0;
+    for (auto& r : retired) {
+      if (r.epoch <= oldest) {
+        r.deleter(r.p);
+      } else {
+        retired[kept++] = r;
+      }
+    }
+    retired.resize(kept);
+  }
+
+  std::atomic<std::uint64_t> global{1};
+  Block head;
+  std::mutex retiredMutex;
+  std::vector<Retired> retired;
+};
+
+/**
+ * name to callable registry, reads are lock-free,
+ * writers replace or add handlers atomically while readers keep calling.
+ */
+template <typename Signature>
+class Registry;
+
+template <typename R, typename... Args>
+class Registry<R(Args...)> {
+ public:
+  using Handler = std::function<R(Args...)>;
+
+  Registry() : current(new Snapshot()) {}
+  ~Registry() {
+    EpochDomain::instance().synchronize();
+    delete current.load();
+  }
+  Registry(const Registry&) = delete;
+  Registry& operator=(const Registry&) = delete;
+
+  /**
+   * call the handler registered as `name`,
+   * throws std::out_of_range if there is none.
+   */
+  R call(std::string_view name, Args... args) const {
+    EpochDomain::ReadGuard guard;
+    const Snapshot* snapshot = current.load(std::memory_order_seq_cst);
+    const auto found = snapshot->handlers.find(name);
+    if (found == snapshot->handlers.end()) {
+      throw std::out_of_range("no handler: " + std::string(name));
+    }
+    return found->second(std::forward<Args>(args)...);
+  }
+
+  bool contains(std::string_view name) const {
+    EpochDomain::ReadGuard guard;
+    return current.load(std::memory_order_seq_cst)->handlers.count(name) != 0;
+  }
+
+  // add or replace
+  void set(std::string name, Handler handler) {
+    update([&](Snapshot& next) { next.set(std::move(name), std::move(handler)); });
+  }
+
+  bool erase(std::string_view name) {
+    bool erased = false;
+    update([&](Snapshot& next) { erased = next.erase(name); });
+    return erased;
+  }
+
+ private:
+  // immutable once published
+  struct Snapshot {
+    std::unordered_map<std::string_view, Handler> handlers;  // keys view `names`
+    std::deque<std::string> names;
+
+    Snapshot() = default;
+    Snapshot(const Snapshot& other) {
+      for (const auto& [name, handler] : other.handlers) {
+        set(std::string(name), handler);
+      }
+    }
+
+    void set(std::string name, Handler handler) {
+      const auto found = handlers.find(name);
+      if (found != handlers.end()) {
+        found->second = std::move(handler);
+        return;
+      }
+      names.push_back(std::move(name));
+      handlers.emplace(names.back(), std::move(handler));
+    }
+
+    bool erase(std::string_view name) {
+      // the name itself stays in `names` until the next copy
+      return handlers.erase(name) != 0;
+    }
+  };
+
+  template <typename Modify>
+  void update(Modify&& modify) {
+    std::lock_guard<std::mutex> lock(writer);
+    auto* next = new Snapshot(*current.load(std::memory_order_relaxed));
+    modify(*next);
+    const Snapshot* previous = current.exchange(next, std::memory_order_seq_cst);
+    EpochDomain::instance().retire(
+        const_cast<Snapshot*>(previous),
+        [](void* p) { delete static_cast<Snapshot*>(p); });
+  }
+
+  std::atomic<const Snapshot*> current;
+  std::mutex writer;
+};
+
+/**
+ * the same registry guarded by a reader-writer lock, for comparison
+ */
+template <typename R, typename... Args>
+class LockedRegistry {
+ public:
+  R call(const std::string& name, Args... args) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return handlers.at(name)(std::forward<Args>(args)...);
+  }
+  void set(std::string name, std::function<R(Args...)> handler) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    handlers[std::move(name)] = std::move(handler);
+  }
+
+ private:
+  mutable std::shared_mutex mutex;
+  std::unordered_map<std::string, std::function<R(Args...)>> handlers;
+};
+
+//
+
+int twice(int i) { return 2 * i; }
+
+struct Klass {
+  int offset;
+  int add(int i) const { return i + offset; }
+};
+
+int main() {
+  Registry<int(int)> registry;
+  CHECK("empty", !registry.contains("twice"));
+
+  // every kind of callable
+  registry.set("twice", &twice);
+  registry.set("square", [](int i) { return i * i; });
+  Klass obj{100};
+  registry.set("add", std::bind(&Klass::add, &obj, std::placeholders::_1));
+  CHECK_VALUE("free function", registry.call("twice", 21), 42);
+  CHECK_VALUE("lambda", registry.call("square", 7), 49);
+  CHECK_VALUE("member function", registry.call("add", 1), 101);
+
+  // hot swap
+  registry.set("twice", [](int i) { return i + i + 0; });
+  CHECK_VALUE("replace", registry.call("twice", 4), 8);
+  CHECK("erase", registry.erase("square"));
+  CHECK("erase", !registry.contains("square"));
+  try {
+    registry.call("square", 1);
+    CHECK_FAILED("out_of_range");
+  } catch (const std::out_of_range&) {
+  }
+
+  // readers always see a complete and increasing version while a writer swaps
+  {
+    Registry<std::string(int)> versions;
+    versions.set("version", [](int) { return std::string(64, '0'); });
+    std::atomic<bool> running{true};
+    std::atomic<bool> monotonic{true};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+      readers.emplace_back([&] {
+        std::string last;
+        for (int i = 0; i < 20000; ++i) {
+          auto version = versions.call("version", i);
+          if (version < last) monotonic = false;
+          last = std::move(version);
+        }
+      });
+    }
+    std::thread writer([&] {
+      for (int v = 1; running; ++v) {
+        auto s = std::to_string(v);
+        s.insert(0, 64 - s.size(), '0');  // fixed width, compares like numbers
+        versions.set("version", [s](int) { return s; });
+        std::this_thread::yield();
+      }
+    });
+    for (auto& reader : readers) reader.join();
+    running = false;
+    writer.join();
+    CHECK("monotonic", monotonic.load());
+  }
+
+  // more concurrent readers than one block of slots
+  {
+    constexpr int kReaders = 300;
+    std::atomic<int> arrived{0};
+    std::atomic<int> correct{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < kReaders; ++t) {
+      readers.emplace_back([&] {
+        correct += registry.call("twice", 2) == 4;  // takes a slot until the thread exits
+        ++arrived;
+        while (arrived < kReaders) std::this_thread::yield();
+      });
+    }
+    for (auto& reader : readers) reader.join();
+    CHECK_VALUE("readers", correct.load(), kReaders);
+    registry.set("twice", &twice);  // reclaims with all blocks scanned
+    CHECK_VALUE("readers", registry.call("twice", 3), 6);
+  }
+
+  // benchmark read throughput under hot swapping
+  const int kThreads = std::max(2u, std::thread::hardware_concurrency());
+  constexpr int kCalls = 20000;
+  auto underLoad = [&](auto& reg) {
+    std::atomic<bool> running{true};
+    std::thread writer([&] {
+      for (int v = 0; running; ++v) {
+        reg.set("handler", [v](int i) { return i + v; });
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    });
+    std::vector<std::thread> readers;
+    for (int t = 0; t < kThreads; ++t) {
+      readers.emplace_back([&] {
+        int sum = 0;
+        for (int i = 0; i < kCalls; ++i) sum += reg.call("handler", i);
+        Harness::doNotOptimize(sum);
+      });
+    }
+    for (auto& reader : readers) reader.join();
+    running = false;
+    writer.join();
+  };
+  Registry<int(int)> rcu;
+  rcu.set("handler", [](int i) { return i; });
+  LockedRegistry<int, int> locked;
+  locked.set("handler", [](int i) { return i; });
+  Harness::benchmark("Registry", [&] { underLoad(rcu); });
+  Harness::benchmark("LockedRegistry", [&] { underLoad(locked); });
+
+  return 0;
+}
+
+}  // namespace FunctionRegistry
@@ -0,0 +1,663 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "main.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Test and benchmark harness.
+ *
+ * Every `RUN_TEST` and every `Harness::benchmark` reports wall time together
+ * with hardware counters: cycles, instructions, IPC, L1d/LLC misses and branch
+ * misses. The counters are opened as one perf_event group so that they are
+ * scheduled on the PMU together and their ratios are meaningful.
+ *
+ * Benchmark samples can be stored as a baseline and a later run can be
+ * compared against it. The baseline collects several runs, a benchmark
+ * regresses if its median is slower than the median of the slowest baseline
+ * run by more than `--threshold` and a one-sided Mann-Whitney U test against
+ * the samples of all baseline runs is significant at `--alpha`. Using a rank
+ * test keeps single outliers (page faults, preemption) from failing or hiding
+ * a regression. With dozens of benchmarks per run some would pass the test by
+ * chance alone, so the p-values are corrected with the Holm-Bonferroni method,
+ * which keeps the probability of any false regression in a run below
+ * `--alpha`.
+ *
+ * A sweep runs a workload at thread counts 1, 2, 4 ... N with every worker
+ * pinned to its own cpu (sched_setaffinity). The placement follows the cpu
+ * topology from sysfs, so e.g. "smt" only puts two workers on the siblings of
+ * one core once every physical core is busy.
+ *
+ * https://man7.org/linux/man-pages/man2/perf_event_open.2.html
+ * https://man7.org/linux/man-pages/man2/sched_setaffinity.2.html
+ * https://www.kernel.org/doc/html/latest/admin-guide/cputopology.html
+ * https://www.brendangregg.com/perf.html
+ * https://en.wikipedia.org/wiki/Mann%E2%80%93Whitney_U_test
+ */
+
+namespace Harness {
+
+namespace {
+
+std::int64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+#ifdef __linux__
+struct EventSpec {
+  std::uint32_t type;
+  std::uint64_t config;
+};
+
+// same order as the fields of `Counters`
+constexpr EventSpec kEventSpecs[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+int openEvent(const EventSpec& spec, int groupFd) {
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = spec.type;
+  attr.config = spec.config;
+  attr.disabled = groupFd == -1 ? 1 : 0;
+  // user space only, which is allowed with perf_event_paranoid <= 2
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // count threads started while the counter is open, they are added when
+  // they exit. inherited events can not be read as a group.
+  attr.inherit = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1 /* any cpu */,
+              groupFd, 0));
+}
+#endif
+
+Options& mutableOptions() {
+  static Options opts;
+  return opts;
+}
+
+// name of the innermost `Measure`, i.e. the running test
+std::string& currentScope() {
+  static std::string scope;
+  return scope;
+}
+
+// benchmark key -> sample times in ns, in the order of execution
+using Samples = std::map<std::string, std::vector<double>>;
+
+// benchmark key -> the samples of every baseline run
+using Runs = std::map<std::string, std::vector<std::vector<double>>>;
+
+Samples& recordedSamples() {
+  static Samples samples;
+  return samples;
+}
+
+std::vector<std::string> recordedOrder;
+
+double median(std::vector<double> v) {
+  if (v.empty()) return 0.0;
+  const auto mid = v.begin() + v.size() / 2;
+  std::nth_element(v.begin(), mid, v.end());
+  return *mid;
+}
+
+[[noreturn]] void usage(const char* argv0) {
+  std::cerr << "usage: " << argv0
+            << " [--samples N] [--save-baseline FILE]"
+               " [--compare-baseline FILE] [--threshold X] [--alpha P]"
+               " [--sweep FILTER] [--placement none|compact|smt|numa]"
+               " [--max-threads N]"
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+/*
+ * baseline file, one benchmark of one run per line:
+ *   <test>/<title> <n> <sample ns>...
+ * saving appends, so the file collects the samples of several runs
+ */
+bool saveBaseline(const std::string& path, const Samples& samples) {
+  const bool exists = static_cast<bool>(std::ifstream(path));
+  std::ofstream out(path, std::ios::app);
+  if (!out) return false;
+  if (!exists) out << "# benchmark baseline: <name> <n> <sample ns>...\n";
+  for (const auto& [name, times] : samples) {
+    out << name << ' ' << times.size();
+    for (double t : times) out << ' ' << static_cast<std::int64_t>(t);
+    out << '\n';
+  }
+  return static_cast<bool>(out);
+}
+
+// far more samples per benchmark than anyone runs, a corrupt count is not
+// allocated
+constexpr long long kMaxBaselineSamples = 1 << 20;
+
+bool loadBaseline(const std::string& path, Runs& runs) {
+  std::ifstream in(path);
+  if (!in) return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream fields(line);
+    std::string name;
+    long long n = 0;  // signed: a size_t would take "-1" as 2^64 - 1
+    if (!(fields >> name >> n) || n < 0 || n > kMaxBaselineSamples) return false;
+    auto& times = runs[name].emplace_back(static_cast<std::size_t>(n));
+    for (auto& t : times) {
+      if (!(fields >> t)) return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * cpu topology
+ */
+struct Cpu {
+  int id;
+  int package;
+  int core;
+  int node;
+};
+
+int readInt(const std::string& path, int fallback) {
+  std::ifstream in(path);
+  int value;
+  return (in >> value) ? value : fallback;
+}
+
+// "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  std::istringstream ranges(list);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    int first = 0;
+    int last = 0;
+    const int n = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+    if (n < 1) continue;
+    if (n == 1) last = first;
+    for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// the cpus this process may run on, in the order workers are placed on them
+std::vector<int> placementOrder(Placement placement) {
+  std::vector<Cpu> cpus;
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+  std::map<int, int> nodeOf;
+  for (int node = 0;; ++node) {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!std::getline(in, list)) break;
+    for (int cpu : parseCpuList(list)) nodeOf[cpu] = node;
+  }
+  for (int id = 0; id < CPU_SETSIZE; ++id) {
+    if (!CPU_ISSET(id, &allowed)) continue;
+    const auto topology = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+    cpus.push_back({id, readInt(topology + "physical_package_id", 0),
+                    readInt(topology + "core_id", id), nodeOf.count(id) ? nodeOf[id] : 0});
+  }
+#endif
+  if (cpus.empty()) {
+    const int n = std::max(1u, std::thread::hardware_concurrency());
+    for (int id = 0; id < n; ++id) cpus.push_back({id, 0, id, 0});
+  }
+
+  // rank of a cpu among the SMT siblings of its core (cpus are in id order)
+  std::map<std::pair<int, int>, int> siblings;
+  std::map<int, int> sibling;
+  for (const auto& cpu : cpus) sibling[cpu.id] = siblings[{cpu.package, cpu.core}]++;
+  // rank of a core within its NUMA node
+  std::map<std::pair<int, int>, int> coreRank;
+  std::map<int, int> coresOfNode;
+  for (const auto& [core, siblingCount] : siblings) {
+    for (const auto& cpu : cpus) {
+      if (std::make_pair(cpu.package, cpu.core) == core) {
+        coreRank[core] = coresOfNode[cpu.node]++;
+        break;
+      }
+    }
+  }
+
+  auto key = [&](const Cpu& cpu) {
+    const int sib = sibling[cpu.id];
+    switch (placement) {
+      case Placement::Compact:
+        return std::make_tuple(cpu.package, cpu.core, sib);
+      case Placement::Numa:
+        return std::make_tuple(sib, coreRank[{cpu.package, cpu.core}], cpu.node);
+      default:
+        return std::make_tuple(sib, cpu.package, cpu.core);
+    }
+  };
+  std::stable_sort(cpus.begin(), cpus.end(),
+                   [&](const Cpu& a, const Cpu& b) { return key(a) < key(b); });
+
+  std::vector<int> order;
+  for (const auto& cpu : cpus) order.push_back(cpu.id);
+  return order;
+}
+
+void pinTo(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+// wall time of one run of `workload` with `workers` threads
+std::int64_t runPinned(const Workload& workload, unsigned workers,
+                       const std::vector<int>& order, bool pin) {
+  std::atomic<unsigned> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads;
+  for (unsigned w = 0; w < workers; ++w) {
+    threads.emplace_back([&, w] {
+      if (pin) pinTo(order[w % order.size()]);
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+      workload(w, workers);
+    });
+  }
+  while (ready.load() < workers) std::this_thread::yield();
+  const auto start = nowNs();
+  go.store(true, std::memory_order_release);
+  for (auto& thread : threads) thread.join();
+  return nowNs() - start;
+}
+
+const char* placementName(Placement placement) {
+  switch (placement) {
+    case Placement::None: return "none";
+    case Placement::Compact: return "compact";
+    case Placement::Smt: return "smt";
+    case Placement::Numa: return "numa";
+  }
+  return "?";
+}
+
+// return true if no benchmark regressed
+bool compareBaseline(const Runs& baseline, const Samples& current) {
+  const auto& opts = options();
+  std::cout << "Baseline: " << opts.compareBaseline << std::endl;
+
+  struct Comparison {
+    const std::string* name;
+    double before;
+    double after;
+    double change;
+    double p;
+    bool regressed = false;
+  };
+  std::vector<Comparison> comparisons;
+  for (const auto& name : recordedOrder) {
+    const auto& times = current.at(name);
+    const auto found = baseline.find(name);
+    if (found == baseline.end() || found->second.empty()) {
+      std::cout << "  [new] " << name << std::endl;
+      continue;
+    }
+    // the slowest baseline run is the reference: a single run can be off by
+    // more than the threshold (frequency scaling, memory layout, neighbours
+    // on a shared host), which no test within one run can see
+    double before = 0.0;
+    std::vector<double> pooled;
+    for (const auto& run : found->second) {
+      before = std::max(before, median(run));
+      pooled.insert(pooled.end(), run.begin(), run.end());
+    }
+    const double after = median(times);
+    const double change = before > 0 ? after / before - 1.0 : 0.0;
+    comparisons.push_back(
+        {&name, before, after, change, mannWhitneyGreater(times, pooled)});
+  }
+
+  // Holm-Bonferroni: the i-th smallest of m p-values is tested at
+  // alpha / (m - i), stop at the first one which is not significant
+  std::vector<Comparison*> byP;
+  for (auto& c : comparisons) byP.push_back(&c);
+  std::sort(byP.begin(), byP.end(),
+            [](const Comparison* a, const Comparison* b) { return a->p < b->p; });
+  for (std::size_t i = 0; i < byP.size(); ++i) {
+    if (byP[i]->p >= opts.alpha / double(byP.size() - i)) break;
+    byP[i]->regressed = byP[i]->change > opts.threshold;
+  }
+
+  bool passed = true;
+  for (const auto& c : comparisons) {
+    passed = passed && !c.regressed;
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "  [%s] %s: %.3f ms -> %.3f ms (%+.1f%%, p=%.4f)",
+                  c.regressed ? "REGRESSED" : "ok", c.name->c_str(),
+                  c.before * 1e-6, c.after * 1e-6, c.change * 100.0, c.p);
+    (c.regressed ? std::cerr : std::cout) << line << std::endl;
+  }
+  return passed;
+}
+
+}  // namespace
+
+CounterGroup::CounterGroup() {
+  std::fill(std::begin(fds), std::end(fds), -1);
+#ifdef __linux__
+  fds[0] = openEvent(kEventSpecs[0], -1);
+  if (fds[0] < 0) return;  // no counters at all, e.g. seccomp or paranoid
+  for (int i = 1; i < kEvents; ++i) {
+    fds[i] = openEvent(kEventSpecs[i], fds[0]);
+  }
+#endif
+}
+
+CounterGroup::~CounterGroup() {
+#ifdef __linux__
+  for (int fd : fds) {
+    if (fd >= 0) close(fd);
+  }
+#endif
+}
+
+void CounterGroup::start() {
+#ifdef __linux__
+  if (fds[0] < 0) return;
+  // no PERF_EVENT_IOC_RESET: it neither clears the counts of exited child
+  // threads nor the enabled/running times, so samples are deltas instead
+  for (int i = 0; i < kEvents; ++i) {
+    if (fds[i] < 0 || read(fds[i], started[i], sizeof(started[i])) != sizeof(started[i])) {
+      std::fill(std::begin(started[i]), std::end(started[i]), 0);
+    }
+  }
+  ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+Counters CounterGroup::stop() {
+  Counters counters;
+#ifdef __linux__
+  if (fds[0] < 0) return counters;
+  ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  std::int64_t* fields[kEvents] = {&counters.cycles, &counters.instructions,
+                                   &counters.l1dMisses, &counters.llcMisses,
+                                   &counters.branchMisses};
+  bool any = false;
+  for (int i = 0; i < kEvents; ++i) {
+    if (fds[i] < 0) continue;
+    // { value, time_enabled, time_running }
+    std::uint64_t buffer[3] = {};
+    if (read(fds[i], buffer, sizeof(buffer)) != sizeof(buffer)) continue;
+    const std::uint64_t value = buffer[0] - started[i][0];
+    const std::uint64_t enabled = buffer[1] - started[i][1];
+    const std::uint64_t running = buffer[2] - started[i][2];
+    if (running == 0) continue;  // never scheduled on the PMU in this sample
+    // scale up if the event was multiplexed with other events
+    const double scale = double(enabled) / double(running);
+    *fields[i] = static_cast<std::int64_t>(value * scale);
+    any = true;
+  }
+  if (!any) return counters;
+  counters.valid = true;
+#endif
+  return counters;
+}
+
+void report(const std::string& title, double seconds,
+            const Counters& counters, bool poolThreads) {
+  Format::Buffer<512> line;
+  line << "  [perf] " << title << ": ";
+  line.fixed(seconds * 1e3, 3) << " ms";
+  if (!counters.valid) {
+    line << " | counters n/a\n";
+    Format::print(stdout, line);
+    return;
+  }
+  auto count = [&](const char* name, std::int64_t value) {
+    line << " | " << name << ' ';
+    if (value < 0) {
+      line << "n/a";
+    } else {
+      line << value;
+    }
+  };
+  count("cycles", counters.cycles);
+  count("instr", counters.instructions);
+  line << " | IPC ";
+  line.fixed(counters.ipc(), 2);
+  count("L1d-miss", counters.l1dMisses);
+  count("LLC-miss", counters.llcMisses);
+  count("br-miss", counters.branchMisses);
+  if (poolThreads) line << " | calling thread only";
+  line << '\n';
+  Format::print(stdout, line);
+}
+
+const Options& options() { return mutableOptions(); }
+
+void parseOptions(int argc, char** argv) {
+  auto& opts = mutableOptions();
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) usage(argv[0]);
+    if (!std::strcmp(arg, "--samples")) {
+      opts.samples = std::atoi(value);
+      if (opts.samples < 1) usage(argv[0]);
+    } else if (!std::strcmp(arg, "--save-baseline")) {
+      opts.saveBaseline = value;
+    } else if (!std::strcmp(arg, "--compare-baseline")) {
+      opts.compareBaseline = value;
+    } else if (!std::strcmp(arg, "--threshold")) {
+      // atof would turn "abc" into 0, i.e. every benchmark regresses
+      char* end = nullptr;
+      opts.threshold = std::strtod(value, &end);
+      if (end == value || *end || !(opts.threshold >= 0)) usage(argv[0]);
+    } else if (!std::strcmp(arg, "--alpha")) {
+      char* end = nullptr;
+      opts.alpha = std::strtod(value, &end);
+      if (end == value || *end || !(opts.alpha > 0 && opts.alpha < 1)) usage(argv[0]);
+    } else if (!std::strcmp(arg, "--sweep")) {
+      opts.sweep = true;
+      opts.sweepFilter = value;
+    } else if (!std::strcmp(arg, "--placement")) {
+      const std::string name = value;
+      if (name == "none") {
+        opts.placement = Placement::None;
+      } else if (name == "compact") {
+        opts.placement = Placement::Compact;
+      } else if (name == "smt") {
+        opts.placement = Placement::Smt;
+      } else if (name == "numa") {
+        opts.placement = Placement::Numa;
+      } else {
+        usage(argv[0]);
+      }
+    } else if (!std::strcmp(arg, "--max-threads")) {
+      // atoi would turn "-1" into 4 billion threads
+      char* end = nullptr;
+      const long n = std::strtol(value, &end, 10);
+      if (end == value || *end || n < 1) usage(argv[0]);
+      opts.maxThreads = static_cast<unsigned>(n);
+    } else {
+      usage(argv[0]);
+    }
+    ++i;
+  }
+}
+
+int finish() {
+  const auto& opts = options();
+  const auto& samples = recordedSamples();
+  if (!opts.compareBaseline.empty()) {
+    Runs baseline;
+    if (!loadBaseline(opts.compareBaseline, baseline)) {
+      std::cerr << "[FAILED] [baseline] cannot read " << opts.compareBaseline
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (!compareBaseline(baseline, samples)) return EXIT_FAILURE;
+  }
+  if (!opts.saveBaseline.empty()) {
+    if (!saveBaseline(opts.saveBaseline, samples)) {
+      std::cerr << "[FAILED] [baseline] cannot write " << opts.saveBaseline
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "Baseline saved: " << opts.saveBaseline << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
+
+double mannWhitneyGreater(const std::vector<double>& x,
+                          const std::vector<double>& y) {
+  const double n1 = x.size();
+  const double n2 = y.size();
+  if (n1 == 0 || n2 == 0) return 1.0;
+
+  // rank the pooled samples, ties get the average rank
+  std::vector<std::pair<double, bool>> pooled;  // (value, from x)
+  for (double v : x) pooled.emplace_back(v, true);
+  for (double v : y) pooled.emplace_back(v, false);
+  std::sort(pooled.begin(), pooled.end());
+
+  double rankSumX = 0.0;
+  double tieTerm = 0.0;  // sum of t^3 - t over tie groups
+  for (std::size_t i = 0; i < pooled.size();) {
+    std::size_t j = i;
+    while (j < pooled.size() && pooled[j].first == pooled[i].first) ++j;
+    const double t = j - i;
+    const double rank = (i + 1 + j) / 2.0;  // average of ranks i+1 .. j
+    for (std::size_t k = i; k < j; ++k) {
+      if (pooled[k].second) rankSumX += rank;
+    }
+    tieTerm += t * t * t - t;
+    i = j;
+  }
+
+  const double u = rankSumX - n1 * (n1 + 1) / 2.0;
+  const double n = n1 + n2;
+  const double mean = n1 * n2 / 2.0;
+  const double variance =
+      n1 * n2 / 12.0 * ((n + 1) - tieTerm / (n * (n - 1)));
+  if (variance <= 0) return u > mean ? 0.0 : 1.0;
+  const double z = (u - mean - 0.5) / std::sqrt(variance);
+  return 0.5 * std::erfc(z / std::sqrt(2.0));  // P(Z >= z)
+}
+
+Measure::Measure(std::string title) : title(std::move(title)) {
+  outerScope = currentScope();
+  currentScope() = this->title;
+  startNs = nowNs();
+  group.start();
+}
+
+Measure::~Measure() {
+  const auto counters = group.stop();
+  report(title, (nowNs() - startNs) * 1e-9, counters, false);
+  currentScope() = outerScope;
+}
+
+void benchmark(const std::string& title, const std::function<void()>& sample,
+               bool poolThreads) {
+  const int kSamples = options().samples;
+
+  sample();  // warm up caches, page in memory
+
+  CounterGroup group;
+  std::vector<std::int64_t> times;
+  std::vector<Counters> counters;
+  for (int i = 0; i < kSamples; ++i) {
+    const auto start = nowNs();
+    group.start();
+    sample();
+    counters.push_back(group.stop());
+    times.push_back(nowNs() - start);
+  }
+
+  // report the sample with median time
+  std::vector<int> order(kSamples);
+  for (int i = 0; i < kSamples; ++i) order[i] = i;
+  std::nth_element(order.begin(), order.begin() + kSamples / 2, order.end(),
+                   [&](int a, int b) { return times[a] < times[b]; });
+  const int mid = order[kSamples / 2];
+  report(title, times[mid] * 1e-9, counters[mid], poolThreads);
+
+  auto name = currentScope().empty() ? title : currentScope() + "/" + title;
+  std::replace(name.begin(), name.end(), ' ', '_');
+  auto& recorded = recordedSamples()[name];
+  if (recorded.empty()) recordedOrder.push_back(name);
+  recorded.insert(recorded.end(), times.begin(), times.end());
+}
+
+void sweep(const std::string& title, std::size_t items, const Workload& workload) {
+  const auto& opts = options();
+  const auto name = currentScope().empty() ? title : currentScope() + "/" + title;
+  if (!opts.sweep || name.find(opts.sweepFilter) == std::string::npos) return;
+
+  const auto order = placementOrder(opts.placement);
+  const bool pin = opts.placement != Placement::None;
+  const unsigned maxThreads = opts.maxThreads ? opts.maxThreads : order.size();
+  std::vector<unsigned> counts;
+  for (unsigned n = 1; n < maxThreads; n *= 2) counts.push_back(n);
+  counts.push_back(maxThreads);
+
+  std::cout << "  [sweep] " << name << " (" << placementName(opts.placement) << ", cpus";
+  for (unsigned w = 0; w < maxThreads; ++w) std::cout << ' ' << order[w % order.size()];
+  std::cout << ")" << std::endl;
+  std::cout << "    threads   time ms   Mitems/s   speedup  efficiency" << std::endl;
+
+  double single = 0.0;
+  for (unsigned workers : counts) {
+    runPinned(workload, workers, order, pin);  // warm up
+    std::vector<double> times;
+    for (int i = 0; i < opts.samples; ++i) {
+      times.push_back(runPinned(workload, workers, order, pin));
+    }
+    const double seconds = median(times) * 1e-9;
+    if (workers == 1) single = seconds;
+    const double speedup = seconds > 0 ? single / seconds : 0.0;
+    char line[128];
+    std::snprintf(line, sizeof(line), "    %7u %9.3f %10.1f %9.2f %10.0f%%", workers,
+                  seconds * 1e3, seconds > 0 ? items / seconds * 1e-6 : 0.0, speedup,
+                  speedup / workers * 100.0);
+    std::cout << line << std::endl;
+  }
+}
+
+}  // namespace Harness
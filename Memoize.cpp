@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "FunctionPointer.h"
+#include "TupleHash.h"
+#include "main.h"
+
+/*
+ * Memoization of pure functions in a sharded, thread-safe LRU cache.
+ *
+ * `memoize(f, capacity)` wraps any callable (like `FunctionPointer::func`)
+ * whose decayed arguments are hashable and comparable:
+ * - the arguments as a tuple are the key, hashed by `TupleHash` like the keys
+ *   of FlatHashMap. the hash selects a shard, every shard has its own lock,
+ *   LRU list and `capacity / shards` entries.
+ * - an entry holds a `std::shared_future` of the result. The first caller of
+ *   a key inserts it and computes the result outside the lock, concurrent
+ *   callers of the same key find the entry and wait for that one computation
+ *   (in-flight deduplication).
+ * - a failed computation passes its exception to all waiters and is not cached.
+ * - hits, misses and evictions are counted per shard.
+ *
+ * https://en.wikipedia.org/wiki/Memoization
+ * https://en.wikipedia.org/wiki/Cache_replacement_policies#LRU
+ */
+
+namespace Memoize {
+
+struct Stats {
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+  std::size_t evictions = 0;
+};
+
+template <typename Signature>
+class Memoized;
+
+template <typename R, typename... Args>
+class Memoized<R(Args...)> {
+  static_assert(!std::is_void_v<R>, "nothing to memoize");
+
+ public:
+  using Key = std::tuple<std::decay_t<Args>...>;
+
+  Memoized(std::function<R(Args...)> f, std::size_t capacity, std::size_t shardCount = 16)
+      : f(std::move(f)), shards(std::max<std::size_t>(shardCount, 1)) {
+    for (auto& shard : shards) {
+      shard = std::make_unique<Shard>();
+      shard->capacity = std::max<std::size_t>(capacity / shards.size(), 1);
+    }
+  }
+
+  R operator()(Args... args) {
+    Key key(args...);
+    auto& shard = *shards[TupleHash()(key) % shards.size()];
+
+    std::promise<R> promise;
+    std::shared_future<R> result;
+    bool compute = false;
+    std::uint64_t ticket = 0;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      const auto found = shard.index.find(key);
+      if (found != shard.index.end()) {
+        ++shard.stats.hits;
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second);  // most recent
+        result = found->second->result;
+      } else {
+        ++shard.stats.misses;
+        compute = true;
+        result = promise.get_future().share();
+        ticket = ++shard.tickets;
+        shard.lru.push_front({key, result, ticket});
+        shard.index.emplace(key, shard.lru.begin());
+        if (shard.lru.size() > shard.capacity) {
+          // an evicted computation still completes for those waiting on it
+          shard.index.erase(shard.lru.back().key);
+          shard.lru.pop_back();
+          ++shard.stats.evictions;
+        }
+      }
+    }
+    if (!compute) return result.get();
+
+    // this caller computes, without holding the lock
+    try {
+      promise.set_value(f(std::forward<Args>(args)...));
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      const auto found = shard.index.find(key);
+      if (found != shard.index.end() && found->second->ticket == ticket) {
+        shard.lru.erase(found->second);
+        shard.index.erase(found);
+      }
+    }
+    return result.get();
+  }
+
+  Stats stats() const {
+    Stats total;
+    for (const auto& shard : shards) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      total.hits += shard->stats.hits;
+      total.misses += shard->stats.misses;
+      total.evictions += shard->stats.evictions;
+    }
+    return total;
+  }
+
+  std::size_t size() const {
+    std::size_t total = 0;
+    for (const auto& shard : shards) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      total += shard->lru.size();
+    }
+    return total;
+  }
+
+ private:
+  struct Entry {
+    Key key;
+    std::shared_future<R> result;
+    std::uint64_t ticket;  // tells a later entry of the same key apart
+  };
+
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    std::list<Entry> lru;  // most recently used first
+    std::unordered_map<Key, typename std::list<Entry>::iterator, TupleHash> index;
+    std::size_t capacity = 1;
+    std::uint64_t tickets = 0;
+    Stats stats;
+  };
+
+  std::function<R(Args...)> f;
+  std::vector<std::unique_ptr<Shard>> shards;
+};
+
+template <typename F>
+struct signature;
+template <typename R, typename... Args>
+struct signature<std::function<R(Args...)>> {
+  using type = R(Args...);
+};
+
+/**
+ * memoized `f`, the signature is deduced like for std::function
+ */
+template <typename F>
+auto memoize(F f, std::size_t capacity, std::size_t shards = 16) {
+  using Signature = typename signature<decltype(std::function(f))>::type;
+  return Memoized<Signature>(std::move(f), capacity, shards);
+}
+
+//
+
+using FunctionPointer::func;
+
+int main() {
+  std::atomic<int> calls{0};
+  auto counted = memoize(
+      [&](std::string s, double d) {
+        ++calls;
+        return func(std::move(s), d);
+      },
+      64);
+  CHECK_VALUE("memoize", counted("100x", 1.23), 123);
+  CHECK_VALUE("memoize", counted("100x", 1.23), 123);
+  CHECK_VALUE("memoize", counted("100x", 3.21), 321);
+  CHECK_VALUE("calls", calls.load(), 2);
+  CHECK_VALUE("hits", counted.stats().hits, 1);
+  CHECK_VALUE("misses", counted.stats().misses, 2);
+
+  // function pointers work as well
+  auto pointer = memoize(&func, 8);
+  CHECK_VALUE("pointer", pointer("default", 3.21), 321);
+
+  // least recently used goes first
+  {
+    int computed = 0;
+    auto square = memoize([&](int i) { return ++computed, i * i; }, 2, 1);
+    square(1), square(2), square(1), square(3);  // evicts 2
+    CHECK_VALUE("evictions", square.stats().evictions, 1);
+    CHECK_VALUE("size", square.size(), 2);
+    square(1);
+    CHECK_VALUE("lru", computed, 3);
+    square(2);
+    CHECK_VALUE("lru", computed, 4);
+  }
+
+  // failures are passed on but not cached
+  {
+    int attempts = 0;
+    auto flaky = memoize(
+        [&](int i) {
+          if (++attempts == 1) throw std::runtime_error("flaky");
+          return i;
+        },
+        8);
+    try {
+      flaky(7);
+      CHECK_FAILED("exception");
+    } catch (const std::runtime_error&) {
+    }
+    CHECK_VALUE("retry", flaky(7), 7);
+    CHECK_VALUE("retry", attempts, 2);
+  }
+
+  // concurrent callers of the same key wait for a single computation
+  {
+    std::atomic<int> computations{0};
+    auto slow = memoize(
+        [&](int i) {
+          ++computations;
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+          return std::to_string(i);
+        },
+        8);
+    std::vector<std::thread> threads;
+    std::atomic<int> correct{0};
+    for (int t = 0; t < 8; ++t) {
+      threads.emplace_back([&] { correct += slow(42) == "42"; });
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK_VALUE("in-flight", computations.load(), 1);
+    CHECK_VALUE("in-flight", correct.load(), 8);
+  }
+
+  // benchmark the hit path under contention: sharded vs one lock
+  constexpr int kKeys = 256;
+  constexpr int kCalls = 1 << 16;
+  auto expensive = [](int i) {
+    double x = i;
+    for (int k = 0; k < 1000; ++k) x = x * 0.999 + 1.0;
+    return x;
+  };
+  auto sharded = memoize(expensive, 2 * kKeys);
+  auto global = memoize(expensive, 2 * kKeys, 1);
+  for (int i = 0; i < kKeys; ++i) sharded(i), global(i);
+
+  // every worker takes its share of the calls, through Harness::sweep from 1
+  // to N pinned threads (`--sweep Memoize`), the plain benchmarks are 1 thread
+  auto hits = [&](auto& memo) -> Harness::Workload {
+    return [&](unsigned worker, unsigned workers) {
+      double sum = 0;
+      for (int i = worker; i < kCalls; i += workers) sum += memo((i * 7) % kKeys);
+      Harness::doNotOptimize(sum);
+    };
+  };
+  const auto shardedHits = hits(sharded);
+  const auto globalHits = hits(global);
+  Harness::benchmark("sharded hit", [&] { shardedHits(0, 1); });
+  Harness::benchmark("one lock hit", [&] { globalHits(0, 1); });
+  Harness::benchmark("recompute", [&] {
+    double sum = 0;
+    for (int i = 0; i < kCalls; ++i) sum += expensive(i % kKeys);
+    Harness::doNotOptimize(sum);
+  });
+  Harness::sweep("sharded hit", kCalls, shardedHits);
+  Harness::sweep("one lock hit", kCalls, globalHits);
+
+  return 0;
+}
+
+}  // namespace Memoize
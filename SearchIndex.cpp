@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "main.h"
+
+/*
+ * Static search indexes over sorted keys.
+ *
+ * Binary search over a large sorted array touches a new cache line at almost
+ * every step, and the next address is only known after the previous load.
+ * Both layouts below store the same keys in a different order:
+ *
+ * - Eytzinger: the implicit binary tree of a heap, the children of node `k`
+ *   are `2k` and `2k + 1`. The first levels share a few cache lines, and the
+ *   16 descendants four levels down are one aligned cache line, so they are prefetched
+ *   while the current level is compared. The search loop has no branch.
+ * - S-tree: an implicit B-tree whose nodes are one cache line of keys
+ *   (16 int32), node `k` has children `k * 17 + i + 1`. One node is searched
+ *   with SSE2 compares (a vectorizable loop without SSE2), so a lookup costs
+ *   one cache miss per level of a tree of height log17(n).
+ *
+ * Batched lookups advance a group of keys level by level together, so the
+ * loads of different keys overlap instead of waiting for each other.
+ *
+ * `StaticEytzinger` builds and searches at compile time from a std::array,
+ * e.g. for membership tests like `Sandbox::isFruit`.
+ *
+ * https://algorithmica.org/en/eytzinger
+ * https://en.algorithmica.org/hpc/data-structures/s-tree/
+ * https://arxiv.org/abs/1509.05053 (Array layouts for comparison-based searching)
+ */
+
+namespace SearchIndex {
+
+namespace detail {
+
+// fill `b[1..n]` in Eytzinger order from the sorted `in`
+template <typename In, typename Out>
+constexpr void eytzinger(const In& in, Out& b, std::size_t& i, std::size_t k, std::size_t n) {
+  if (k <= n) {
+    eytzinger(in, b, i, 2 * k, n);
+    b[k] = in[i++];
+    eytzinger(in, b, i, 2 * k + 1, n);
+  }
+}
+
+// the path of a search ends in a leaf, the answer is where it last went left
+constexpr std::size_t eytzingerResult(std::size_t k) {
+  while (k & 1) k >>= 1;
+  return k >> 1;
+}
+
+template <typename T>
+void prefetch(const T* p) {
+  __builtin_prefetch(p);
+}
+
+template <typename T>
+struct CacheLineAllocator {
+  using value_type = T;
+  CacheLineAllocator() = default;
+  template <typename U>
+  CacheLineAllocator(const CacheLineAllocator<U>&) {}
+  T* allocate(std::size_t count) {
+    return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(64)));
+  }
+  void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t(64)); }
+  bool operator==(const CacheLineAllocator&) const { return true; }
+  bool operator!=(const CacheLineAllocator&) const { return false; }
+};
+
+}  // namespace detail
+
+/**
+ * Eytzinger layout of sorted keys
+ */
+template <typename T>
+class Eytzinger {
+ public:
+  template <typename Sorted>
+  explicit Eytzinger(const Sorted& sorted) : n(std::size(sorted)), lines(kPrefetch + n) {
+    std::size_t i = 0;
+    T* b = lines.data() + kPrefetch - 1;
+    detail::eytzinger(sorted, b, i, 1, n);
+  }
+
+  std::size_t size() const { return n; }
+
+  /**
+   * the smallest key not less than `x`, nullptr if there is none
+   */
+  const T* lower_bound(const T& x) const {
+    const T* b = base();
+    std::size_t k = 1;
+    while (k <= n) {
+      detail::prefetch(b + std::min(k * kPrefetch, n));
+      k = 2 * k + (b[k] < x);
+    }
+    k = detail::eytzingerResult(k);
+    return k ? &b[k] : nullptr;
+  }
+
+  bool contains(const T& x) const {
+    const T* p = lower_bound(x);
+    return p && !(x < *p);
+  }
+
+  /**
+   * `out[i] = lower_bound(keys[i])` for `count` keys
+   */
+  void lower_bound(const T* keys, std::size_t count, const T** out) const {
+    const T* b = base();
+    for (std::size_t first = 0; first < count; first += kLanes) {
+      const std::size_t lanes = std::min(kLanes, count - first);
+      std::size_t k[kLanes];
+      std::fill(k, k + lanes, 1);
+      for (std::size_t level = 0; level < depth(); ++level) {
+        for (std::size_t l = 0; l < lanes; ++l) {
+          if (k[l] <= n) {
+            detail::prefetch(b + std::min(k[l] * kPrefetch, n));
+            k[l] = 2 * k[l] + (b[k[l]] < keys[first + l]);
+          }
+        }
+      }
+      for (std::size_t l = 0; l < lanes; ++l) {
+        const auto r = detail::eytzingerResult(k[l]);
+        out[first + l] = r ? &b[r] : nullptr;
+      }
+    }
+  }
+
+ private:
+  // keys per cache line: the descendants of `k` four levels down start at `16k`.
+  // near the leaves that is past the end, prefetches are clamped to `b[n]`
+  // because forming a pointer beyond `end()` is undefined even unread
+  static constexpr std::size_t kPrefetch = std::max<std::size_t>(1, 64 / sizeof(T));
+  static constexpr std::size_t kLanes = 16;
+
+  std::size_t depth() const {
+    std::size_t d = 0;
+    while ((std::size_t(1) << d) <= n) ++d;
+    return d;
+  }
+
+  // b[0] is unused and sits just before a line boundary, so b[16k..16k+15]
+  // fill exactly one cache line
+  const T* base() const { return lines.data() + kPrefetch - 1; }
+
+  std::size_t n;
+  std::vector<T, detail::CacheLineAllocator<T>> lines;  // b is lines[kPrefetch - 1, kPrefetch + n)
+};
+
+/**
+ * Eytzinger layout of a compile time std::array, built and searched in constexpr
+ */
+template <typename T, std::size_t N>
+class StaticEytzinger {
+ public:
+  constexpr explicit StaticEytzinger(const std::array<T, N>& sorted) : b() {
+    std::size_t i = 0;
+    detail::eytzinger(sorted, b, i, 1, N);
+  }
+
+  constexpr std::size_t size() const { return N; }
+
+  constexpr const T* lower_bound(const T& x) const {
+    std::size_t k = 1;
+    while (k <= N) k = 2 * k + (b[k] < x);
+    k = detail::eytzingerResult(k);
+    return k ? &b[k] : nullptr;
+  }
+
+  constexpr bool contains(const T& x) const {
+    const T* p = lower_bound(x);
+    return p && !(x < *p);
+  }
+
+ private:
+  std::array<T, N + 1> b;
+};
+
+/**
+ * implicit B-tree with nodes of one cache line, for arithmetic keys
+ */
+template <typename T>
+class STree {
+  static_assert(std::is_arithmetic_v<T>, "nodes are padded with the largest value");
+
+ public:
+  template <typename Sorted>
+  explicit STree(const Sorted& sorted)
+      : n(std::size(sorted)),
+        nodes((n + kB - 1) / kB),
+        keys(nodes * kB, std::numeric_limits<T>::max()),
+        largest(n ? *std::prev(std::end(sorted)) : T()) {
+    std::size_t i = 0;
+    build(std::begin(sorted), i, 0);
+  }
+
+  std::size_t size() const { return n; }
+
+  /**
+   * the smallest key not less than `x`, nullptr if there is none
+   */
+  const T* lower_bound(const T& x) const {
+    // otherwise the padding would answer
+    if (n == 0 || largest < x) return nullptr;
+    const T* result = nullptr;
+    for (std::size_t k = 0; k < nodes;) {
+      const T* node = &keys[k * kB];
+      const std::size_t i = rank(node, x);
+      if (i < kB) result = node + i;
+      k = child(k, i);
+    }
+    return result;
+  }
+
+  bool contains(const T& x) const {
+    const T* p = lower_bound(x);
+    return p && *p == x;
+  }
+
+  /**
+   * `out[i] = lower_bound(keys[i])` for `count` keys
+   */
+  void lower_bound(const T* xs, std::size_t count, const T** out) const {
+    for (std::size_t first = 0; first < count; first += kLanes) {
+      const std::size_t lanes = std::min(kLanes, count - first);
+      std::size_t k[kLanes];
+      std::fill(k, k + lanes, 0);
+      for (std::size_t l = 0; l < lanes; ++l) {
+        out[first + l] = nullptr;
+        if (n == 0 || largest < xs[first + l]) k[l] = nodes;  // done
+      }
+      for (bool active = true; active;) {
+        active = false;
+        for (std::size_t l = 0; l < lanes; ++l) {
+          if (k[l] >= nodes) continue;
+          const T* node = &keys[k[l] * kB];
+          const std::size_t i = rank(node, xs[first + l]);
+          if (i < kB) out[first + l] = node + i;
+          k[l] = child(k[l], i);
+          if (k[l] < nodes) detail::prefetch(&keys[k[l] * kB]), active = true;
+        }
+      }
+    }
+  }
+
+ private:
+  static constexpr std::size_t kB = std::max<std::size_t>(1, 64 / sizeof(T));
+  static constexpr std::size_t kLanes = 16;
+
+  static std::size_t child(std::size_t k, std::size_t i) { return k * (kB + 1) + i + 1; }
+
+  // number of keys of the node less than `x`, i.e. the index of the first not less
+  static std::size_t rank(const T* node, const T& x) {
+#if defined(__SSE2__)
+    if constexpr (std::is_same_v<T, std::int32_t>) {
+      const __m128i v = _mm_set1_epi32(x);
+      unsigned mask = 0;
+      for (std::size_t j = 0; j < kB; j += 4) {
+        const __m128i less = _mm_cmpgt_epi32(v, _mm_load_si128(reinterpret_cast<const __m128i*>(node + j)));
+        mask |= unsigned(_mm_movemask_ps(_mm_castsi128_ps(less))) << j;
+      }
+      return __builtin_popcount(mask);
+    }
+#endif
+    std::size_t count = 0;
+    for (std::size_t j = 0; j < kB; ++j) count += node[j] < x;
+    return count;
+  }
+
+  // in-order traversal assigns the sorted keys
+  template <typename Iter>
+  void build(Iter sorted, std::size_t& i, std::size_t k) {
+    if (k >= nodes) return;
+    for (std::size_t j = 0; j < kB; ++j) {
+      build(sorted, i, child(k, j));
+      if (i < n) keys[k * kB + j] = sorted[i++];
+    }
+    build(sorted, i, child(k, kB));
+  }
+
+  std::size_t n;
+  std::size_t nodes;
+  std::vector<T, detail::CacheLineAllocator<T>> keys;  // node k is keys[k * kB, (k + 1) * kB)
+  T largest;
+};
+
+//
+
+// the fruits of Sandbox::Thing, and some more
+constexpr std::array<std::string_view, 5> kFruits = {"Apple", "Banana", "Cherry", "Kiwi", "Mango"};
+constexpr StaticEytzinger<std::string_view, 5> kFruitIndex(kFruits);
+
+constexpr bool isFruit(std::string_view str) { return kFruitIndex.contains(str); }
+
+int main() {
+  static_assert(isFruit("Apple") && isFruit("Mango") && isFruit("Cherry"));
+  static_assert(!isFruit("Cat") && !isFruit("") && !isFruit("Zebra"));
+  static_assert(*kFruitIndex.lower_bound("Coconut") == "Kiwi");
+  static_assert(kFruitIndex.lower_bound("Zebra") == nullptr);
+
+  // every layout agrees with std::lower_bound, at sizes with partial levels and nodes
+  std::mt19937 gen(42);
+  for (std::size_t n : {0, 1, 2, 15, 16, 17, 100, 289, 1000, 4913}) {
+    std::vector<std::int32_t> sorted(n);
+    for (auto& v : sorted) v = static_cast<std::int32_t>(gen() % (4 * n + 1)) - std::int32_t(n);
+    std::sort(sorted.begin(), sorted.end());
+    if (n > 2) sorted.back() = std::numeric_limits<std::int32_t>::max();  // like the padding
+    const Eytzinger<std::int32_t> eytzinger(sorted);
+    const STree<std::int32_t> stree(sorted);
+    const STree<double> streeDouble(std::vector<double>(sorted.begin(), sorted.end()));
+
+    std::vector<std::int32_t> queries;
+    for (std::int32_t x = -std::int32_t(n) - 2; x <= std::int32_t(3 * n) + 2; ++x) queries.push_back(x);
+    queries.push_back(std::numeric_limits<std::int32_t>::max());
+    queries.push_back(std::numeric_limits<std::int32_t>::min());
+    std::vector<const std::int32_t*> batchE(queries.size()), batchS(queries.size());
+    eytzinger.lower_bound(queries.data(), queries.size(), batchE.data());
+    stree.lower_bound(queries.data(), queries.size(), batchS.data());
+
+    for (std::size_t q = 0; q < queries.size(); ++q) {
+      const auto x = queries[q];
+      const auto expected = std::lower_bound(sorted.begin(), sorted.end(), x);
+      auto same = [&](const auto* p) {
+        return expected == sorted.end() ? p == nullptr : p != nullptr && *p == *expected;
+      };
+      if (!same(eytzinger.lower_bound(x)) || !same(batchE[q])) CHECK_FAILED("Eytzinger");
+      if (!same(stree.lower_bound(x)) || !same(batchS[q])) CHECK_FAILED("STree");
+      if (!same(streeDouble.lower_bound(double(x)))) CHECK_FAILED("STree<double>");
+      const bool found = expected != sorted.end() && *expected == x;
+      if (eytzinger.contains(x) != found || stree.contains(x) != found) CHECK_FAILED("contains");
+    }
+  }
+
+  // benchmark against std::lower_bound, from 1K keys to kMaxKeys
+  // (1B int32 keys take 4 GB per layout, raise it on a machine that has them)
+  constexpr std::size_t kMaxKeys = std::size_t(1) << 24;
+  constexpr std::size_t kQueries = 1 << 16;
+  for (std::size_t n = 1 << 10; n <= kMaxKeys; n <<= 7) {
+    std::vector<std::int32_t> sorted(n);
+    for (std::size_t i = 0; i < n; ++i) sorted[i] = static_cast<std::int32_t>(2 * i);
+    std::vector<std::int32_t> queries(kQueries);
+    for (auto& q : queries) q = static_cast<std::int32_t>(gen() % (2 * n - 1));  // all have an answer
+    const Eytzinger<std::int32_t> eytzinger(sorted);
+    const STree<std::int32_t> stree(sorted);
+    std::vector<const std::int32_t*> out(kQueries);
+
+    const auto suffix = n < (1 << 20) ? " " + std::to_string(n >> 10) + "K" : " " + std::to_string(n >> 20) + "M";
+    Harness::benchmark("std::lower_bound" + suffix, [&] {
+      std::int64_t sum = 0;
+      for (auto q : queries) sum += *std::lower_bound(sorted.begin(), sorted.end(), q);
+      Harness::doNotOptimize(sum);
+    });
+    Harness::benchmark("Eytzinger" + suffix, [&] {
+      std::int64_t sum = 0;
+      for (auto q : queries) sum += *eytzinger.lower_bound(q);
+      Harness::doNotOptimize(sum);
+    });
+    Harness::benchmark("Eytzinger batched" + suffix, [&] {
+      eytzinger.lower_bound(queries.data(), kQueries, out.data());
+      Harness::doNotOptimize(out);
+    });
+    Harness::benchmark("STree" + suffix, [&] {
+      std::int64_t sum = 0;
+      for (auto q : queries) sum += *stree.lower_bound(q);
+      Harness::doNotOptimize(sum);
+    });
+    Harness::benchmark("STree batched" + suffix, [&] {
+      stree.lower_bound(queries.data(), kQueries, out.data());
+      Harness::doNotOptimize(out);
+    });
+  }
+
+  return 0;
+}
+
+}  // namespace SearchIndex
@@ -0,0 +1,441 @@
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "main.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Binary serialization of tuples with trivially copyable and string fields.
+ *
+ * record := [u32 size][fixed part][string bytes]
+ *
+ * - the fixed part has a compile time layout: every trivially copyable field is
+ *   stored at a constant offset, a string field as (u32 offset, u32 length)
+ *   into the string bytes of the record.
+ * - fields are packed (no padding) and accessed by memcpy, native byte order.
+ * - writing goes into a caller provided buffer without allocation,
+ *   reading is zero-copy: a `RecordView` reads straight from the buffer (e.g.
+ *   an mmap'ed file) and exposes strings as `std::string_view`.
+ * - `RecordView` trusts its bytes, `Records` checks the size and the string
+ *   fields of every record against the buffer before handing it out, so a
+ *   truncated or corrupt file throws instead of reading out of bounds.
+ * - pointers are trivially copyable but meaningless in a file, they are
+ *   rejected at compile time.
+ *
+ * https://en.cppreference.com/w/cpp/types/is_trivially_copyable
+ * https://capnproto.org/encoding.html
+ */
+
+namespace Serialization {
+
+template <typename T>
+constexpr bool is_string_field_v =
+    std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+
+template <typename T>
+constexpr bool is_serializable_v =
+    is_string_field_v<T> ||
+    (std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> &&
+     !std::is_member_pointer_v<T>);
+
+// type of a field when read through a view
+template <typename T>
+using view_t = std::conditional_t<is_string_field_v<T>, std::string_view, T>;
+
+using Size = std::uint32_t;
+
+/**
+ * compile time layout of the fixed part of a record
+ */
+template <typename... Ts>
+struct Layout {
+  static_assert((is_serializable_v<Ts> && ...), "unsupported field type");
+
+  template <typename T>
+  static constexpr std::size_t fieldSize =
+      is_string_field_v<T> ? 2 * sizeof(Size) : sizeof(T);
+
+  static constexpr std::array<std::size_t, sizeof...(Ts)> offsets = [] {
+    std::array<std::size_t, sizeof...(Ts)> result{};
+    std::size_t sizes[] = {fieldSize<Ts>..., 0};
+    std::size_t offset = sizeof(Size);  // behind the record size
+    for (std::size_t i = 0; i < sizeof...(Ts); ++i) {
+      result[i] = offset;
+      offset += sizes[i];
+    }
+    return result;
+  }();
+
+  static constexpr std::size_t fixedSize = sizeof(Size) + (fieldSize<Ts> + ... + 0);
+};
+
+namespace detail {
+
+template <typename T>
+void store(char* p, const T& value) {
+  std::memcpy(p, &value, sizeof(T));
+}
+
+template <typename T>
+T load(const char* p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+template <typename T>
+std::size_t stringSize(const T& field) {
+  if constexpr (is_string_field_v<T>) {
+    return field.size();
+  } else {
+    return 0;
+  }
+}
+
+}  // namespace detail
+
+/**
+ * exact number of bytes `serialize` writes for `t`
+ */
+template <typename... Ts>
+std::size_t serializedSize(const std::tuple<Ts...>& t) {
+  return std::apply(
+      [](const auto&... field) {
+        return Layout<Ts...>::fixedSize + (detail::stringSize(field) + ... + 0);
+      },
+      t);
+}
+
+/**
+ * write `t` into `buffer`, return the number of bytes written
+ * or 0 if `capacity` is too small or the record does not fit the u32 size.
+ */
+template <typename... Ts>
+std::size_t serialize(const std::tuple<Ts...>& t, char* buffer,
+                      std::size_t capacity) {
+  using L = Layout<Ts...>;
+  const std::size_t size = serializedSize(t);
+  if (size > capacity || size > std::numeric_limits<Size>::max()) return 0;
+
+  detail::store(buffer, static_cast<Size>(size));
+  std::size_t strings = L::fixedSize;
+  auto write = [&](std::size_t offset, const auto& field) {
+    using T = std::decay_t<decltype(field)>;
+    if constexpr (is_string_field_v<T>) {
+      detail::store(buffer + offset, static_cast<Size>(strings));
+      detail::store(buffer + offset + sizeof(Size), static_cast<Size>(field.size()));
+      std::memcpy(buffer + strings, field.data(), field.size());
+      strings += field.size();
+    } else {
+      detail::store(buffer + offset, field);
+    }
+  };
+  std::apply(
+      [&](const auto&... field) {
+        std::size_t i = 0;
+        (write(L::offsets[i++], field), ...);
+      },
+      t);
+  return size;
+}
+
+/**
+ * zero-copy view of a serialized record
+ */
+template <typename... Ts>
+class RecordView {
+ public:
+  using Tuple = std::tuple<Ts...>;
+
+  explicit RecordView(const char* data) : data(data) {}
+
+  std::size_t size() const { return detail::load<Size>(data); }
+
+  /**
+   * true if the record lies within `available` bytes and so do its strings
+   */
+  bool valid(std::size_t available) const {
+    using L = Layout<Ts...>;
+    if (available < L::fixedSize) return false;
+    const std::size_t total = size();
+    if (total < L::fixedSize || total > available) return false;
+    return validStrings(total, std::index_sequence_for<Ts...>());
+  }
+
+  template <std::size_t I>
+  view_t<std::tuple_element_t<I, Tuple>> get() const {
+    using T = std::tuple_element_t<I, Tuple>;
+    const char* field = data + Layout<Ts...>::offsets[I];
+    if constexpr (is_string_field_v<T>) {
+      return std::string_view(data + detail::load<Size>(field),
+                              detail::load<Size>(field + sizeof(Size)));
+    } else {
+      return detail::load<T>(field);
+    }
+  }
+
+  // materialize as the original tuple type (copies strings)
+  Tuple tuple() const {
+    return tuple(std::index_sequence_for<Ts...>());
+  }
+
+ private:
+  template <std::size_t... Is>
+  Tuple tuple(std::index_sequence<Is...>) const {
+    return Tuple(Ts(get<Is>())...);
+  }
+
+  template <std::size_t... Is>
+  bool validStrings(std::size_t total, std::index_sequence<Is...>) const {
+    auto check = [&](std::size_t i, bool isString) {
+      if (!isString) return true;
+      const char* field = data + Layout<Ts...>::offsets[i];
+      const std::size_t offset = detail::load<Size>(field);
+      const std::size_t length = detail::load<Size>(field + sizeof(Size));
+      return offset >= Layout<Ts...>::fixedSize && offset <= total &&
+             length <= total - offset;
+    };
+    return (check(Is, is_string_field_v<Ts>) && ... && true);
+  }
+
+  const char* data;
+};
+
+/**
+ * sequence of records in a contiguous buffer.
+ * throws std::runtime_error on reaching a record which does not fit the
+ * buffer or whose strings do not fit the record.
+ */
+template <typename... Ts>
+class Records {
+ public:
+  Records(const char* begin, const char* end) : first(begin), last(end) {}
+
+  struct iterator {
+    const char* p;
+    const char* last;
+
+    iterator(const char* p, const char* last) : p(p), last(last) { check(); }
+    RecordView<Ts...> operator*() const { return RecordView<Ts...>(p); }
+    iterator& operator++() {
+      p += RecordView<Ts...>(p).size();
+      check();
+      return *this;
+    }
+    bool operator!=(const iterator& other) const { return p != other.p; }
+
+   private:
+    void check() const {
+      if (p != last && !RecordView<Ts...>(p).valid(last - p)) {
+        throw std::runtime_error("Serialization: malformed record");
+      }
+    }
+  };
+
+  iterator begin() const { return {first, last}; }
+  iterator end() const { return {last, last}; }
+
+ private:
+  const char* first;
+  const char* last;
+};
+
+#ifdef __linux__
+/**
+ * read-only memory mapped file
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const char* path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        addr = static_cast<const char*>(p);
+        length = st.st_size;
+      }
+    }
+    close(fd);  // the mapping stays valid
+  }
+  ~MappedFile() {
+    if (addr) munmap(const_cast<char*>(addr), length);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  explicit operator bool() const { return addr != nullptr; }
+  const char* begin() const { return addr; }
+  const char* end() const { return addr + length; }
+
+ private:
+  const char* addr = nullptr;
+  std::size_t length = 0;
+};
+#endif
+
+//
+
+using Record = std::tuple<std::int32_t, double, std::string, std::int64_t>;
+
+std::vector<Record> makeRecords(int n) {
+  std::vector<Record> records;
+  for (int i = 0; i < n; ++i) {
+    records.emplace_back(i, i * 0.5, "name-" + std::to_string(i), -7LL * i);
+  }
+  return records;
+}
+
+int main() {
+  using L = Layout<std::int32_t, double, std::string, std::int64_t>;
+  static_assert(L::offsets[0] == 4 && L::offsets[1] == 8 &&
+                L::offsets[2] == 16 && L::offsets[3] == 24);
+  static_assert(L::fixedSize == 32);
+
+  const Record record{42, 3.5, "Peace and Love", -1};
+  char buffer[64];
+  CHECK_VALUE("serializedSize", serializedSize(record), 32 + 14);
+  CHECK_VALUE("serialize", serialize(record, buffer, sizeof(buffer)), 46);
+  CHECK_VALUE("serialize", serialize(record, buffer, 45), 0);  // too small
+
+  const RecordView<std::int32_t, double, std::string, std::int64_t> view(buffer);
+  CHECK_VALUE("view", view.get<0>(), 42);
+  CHECK_VALUE("view", view.get<1>(), 3.5);
+  CHECK_VALUE("view", view.get<2>(), "Peace and Love");
+  CHECK("view", (view.get<2>().data() == buffer + 32));  // zero-copy
+  CHECK_VALUE("view", view.get<3>(), -1);
+  CHECK("tuple", (view.tuple() == record));
+
+  // views over string_view fields serialize the same way
+  char another[64];
+  serialize(std::make_tuple(std::int32_t(42), 3.5, std::string_view("Peace and Love"),
+                            std::int64_t(-1)),
+            another, sizeof(another));
+  CHECK("string_view", (std::memcmp(buffer, another, 46) == 0));
+
+  // pointers do not survive a file
+  static_assert(!is_serializable_v<const char*>);
+  static_assert(!is_serializable_v<int*>);
+  static_assert(!is_serializable_v<int Record::*>);
+
+  // corrupt input throws instead of reading out of bounds
+  {
+    using Records4 = Records<std::int32_t, double, std::string, std::int64_t>;
+    auto count = [](const char* first, const char* last) {
+      std::size_t n = 0;
+      try {
+        for (auto r : Records4(first, last)) n += r.get<2>().size() > 0;
+      } catch (const std::runtime_error&) {
+        return std::size_t(-1);
+      }
+      return n;
+    };
+    char two[2 * 46];
+    std::memcpy(two, buffer, 46);
+    std::memcpy(two + 46, buffer, 46);
+    CHECK_VALUE("records", count(two, two + 92), 2);
+    CHECK_VALUE("truncated", count(two, two + 91), std::size_t(-1));
+    CHECK_VALUE("truncated", count(two, two + 48), std::size_t(-1));  // < u32 + fixed part
+    char bad[46];
+    std::memcpy(bad, buffer, 46);
+    detail::store(bad, Size(8));  // smaller than the fixed part, would not advance past it
+    CHECK_VALUE("size", count(bad, bad + 46), std::size_t(-1));
+    std::memcpy(bad, buffer, 46);
+    detail::store(bad + L::offsets[2], Size(40));  // string runs past the record
+    CHECK_VALUE("string", count(bad, bad + 46), std::size_t(-1));
+    std::memcpy(bad, buffer, 46);
+    detail::store(bad + L::offsets[2], Size(4));  // string inside the fixed part
+    CHECK_VALUE("string", count(bad, bad + 46), std::size_t(-1));
+  }
+
+  const auto records = makeRecords(10000);
+  std::vector<char> bytes;
+  for (const auto& r : records) {
+    const auto offset = bytes.size();
+    bytes.resize(offset + serializedSize(r));
+    serialize(r, bytes.data() + offset, bytes.size() - offset);
+  }
+
+#ifdef __linux__
+  // zero-copy reading of a record file
+  char path[] = "/tmp/sandbox-records-XXXXXX";
+  const int fd = mkstemp(path);
+  CHECK("mkstemp", (fd >= 0));
+  CHECK("write", (write(fd, bytes.data(), bytes.size()) == ssize_t(bytes.size())));
+  close(fd);
+  {
+    MappedFile file(path);
+    CHECK("mmap", static_cast<bool>(file));
+    std::size_t i = 0;
+    for (auto r : Records<std::int32_t, double, std::string, std::int64_t>(
+             file.begin(), file.end())) {
+      if (r.tuple() != records[i]) CHECK_FAILED("mmap records");
+      ++i;
+    }
+    CHECK_VALUE("mmap records", i, records.size());
+  }
+  unlink(path);
+#endif
+
+  // benchmark against iostream based formatting
+  Harness::benchmark("serialize", [&] {
+    std::size_t offset = 0;
+    for (const auto& r : records) {
+      offset += serialize(r, bytes.data() + offset, bytes.size() - offset);
+    }
+    Harness::doNotOptimize(bytes);
+  });
+  Harness::benchmark("ostream", [&] {
+    std::ostringstream out;
+    for (const auto& r : records) {
+      out << std::get<0>(r) << ' ' << std::get<1>(r) << ' ' << std::get<2>(r)
+          << ' ' << std::get<3>(r) << '\n';
+    }
+    Harness::doNotOptimize(out);
+  });
+
+  std::ostringstream text;
+  for (const auto& r : records) {
+    text << std::get<0>(r) << ' ' << std::get<1>(r) << ' ' << std::get<2>(r)
+         << ' ' << std::get<3>(r) << '\n';
+  }
+  const auto formatted = text.str();
+  Harness::benchmark("RecordView", [&] {
+    std::int64_t sum = 0;
+    for (auto r : Records<std::int32_t, double, std::string, std::int64_t>(
+             bytes.data(), bytes.data() + bytes.size())) {
+      sum += r.get<0>() + r.get<2>().size() + r.get<3>();
+    }
+    Harness::doNotOptimize(sum);
+  });
+  Harness::benchmark("istream", [&] {
+    std::istringstream in(formatted);
+    std::int64_t sum = 0;
+    Record r;
+    while (in >> std::get<0>(r) >> std::get<1>(r) >> std::get<2>(r) >> std::get<3>(r)) {
+      sum += std::get<0>(r) + std::get<2>(r).size() + std::get<3>(r);
+    }
+    Harness::doNotOptimize(sum);
+  });
+
+  return 0;
+}
+
+}  // namespace Serialization
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "main.h"
+
+/*
+ * Thread-safe string interner.
+ *
+ * Every distinct string gets a small integer id, so comparing interned names
+ * (e.g. category names like `Sandbox::Thing::Apple` or the results of
+ * `Polymorphism::Base::method()`) becomes an integer compare.
+ *
+ * - sharded: the hash selects one of `kShards` open-addressing tables, each
+ *   with its own lock, so threads interning different strings rarely contend.
+ * - characters are copied once into a per-shard arena of fixed size chunks,
+ *   they never move, therefore the `std::string_view`s stay valid.
+ * - id -> string_view is lock-free: a two level table of segments which are
+ *   published once and never reallocated. this caps the number of ids at 16M,
+ *   `intern` of a new string throws std::length_error beyond that.
+ *
+ * https://en.wikipedia.org/wiki/String_interning
+ * https://en.wikipedia.org/wiki/Open_addressing
+ */
+
+namespace StringInterner {
+
+class Interner {
+  static constexpr unsigned kSegmentBits = 12;
+  static constexpr std::size_t kSegmentSize = std::size_t(1) << kSegmentBits;
+  static constexpr std::size_t kSegments = std::size_t(1) << 12;
+
+ public:
+  using Id = std::uint32_t;
+  static constexpr std::size_t kMaxIds = kSegments * kSegmentSize;  // 16M
+
+  /**
+   * at most `capacity` distinct strings (clamped to kMaxIds)
+   */
+  explicit Interner(std::size_t capacity = kMaxIds) : capacity(std::min(capacity, kMaxIds)) {}
+  ~Interner() {
+    for (auto& segment : segments) delete[] segment.load(std::memory_order_relaxed);
+  }
+  Interner(const Interner&) = delete;
+  Interner& operator=(const Interner&) = delete;
+
+  /**
+   * id of `str`, the same for equal strings (and only for them).
+   * throws std::length_error if `str` is new and all ids are taken.
+   */
+  Id intern(std::string_view str) {
+    const auto hash = std::hash<std::string_view>()(str);
+    auto& shard = shards[hash >> (8 * sizeof(hash) - kShardBits)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto* slot = shard.find(hash, str, *this);
+    if (slot->id != kEmpty) return slot->id;
+
+    Id id = next.load(std::memory_order_relaxed);
+    do {
+      if (id >= capacity) throw std::length_error("Interner: out of ids");
+    } while (!next.compare_exchange_weak(id, id + 1, std::memory_order_relaxed));
+    publish(id, shard.copy(str));
+    *slot = {hash, id};
+    if (++shard.size * 2 > shard.slots.size()) shard.grow();
+    return id;
+  }
+
+  /**
+   * the interned string of `id`, lock-free
+   */
+  std::string_view view(Id id) const {
+    const auto* segment = segments[id >> kSegmentBits].load(std::memory_order_acquire);
+    return segment[id & (kSegmentSize - 1)];
+  }
+
+  std::size_t size() const { return next.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr Id kEmpty = ~Id(0);
+  static constexpr unsigned kShardBits = 6;
+  static constexpr std::size_t kShards = std::size_t(1) << kShardBits;
+  static constexpr std::size_t kChunkSize = 64 * 1024;
+
+  struct Slot {
+    std::size_t hash;
+    Id id = kEmpty;
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::vector<Slot> slots = std::vector<Slot>(64);  // power of 2
+    std::size_t size = 0;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::size_t used = 0;  // of the last chunk
+    std::vector<std::unique_ptr<char[]>> large;
+
+    // the slot holding `str` or the empty slot to insert it (linear probing)
+    Slot* find(std::size_t hash, std::string_view str, const Interner& interner) {
+      const std::size_t mask = slots.size() - 1;
+      for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+        auto& slot = slots[i];
+        if (slot.id == kEmpty ||
+            (slot.hash == hash && interner.view(slot.id) == str)) {
+          return &slot;
+        }
+      }
+    }
+
+    void grow() {
+      std::vector<Slot> old(slots.size() * 2);
+      old.swap(slots);
+      const std::size_t mask = slots.size() - 1;
+      for (const auto& slot : old) {
+        if (slot.id == kEmpty) continue;
+        std::size_t i = slot.hash & mask;
+        while (slots[i].id != kEmpty) i = (i + 1) & mask;
+        slots[i] = slot;
+      }
+    }
+
+    // copy into the arena, large strings get their own allocation
+    std::string_view copy(std::string_view str) {
+      char* p;
+      if (str.size() > kChunkSize / 4) {
+        large.emplace_back(new char[str.size()]);
+        p = large.back().get();
+      } else {
+        if (chunks.empty() || str.size() > kChunkSize - used) {
+          chunks.emplace_back(new char[kChunkSize]);
+          used = 0;
+        }
+        p = chunks.back().get() + used;
+        used += str.size();
+      }
+      std::memcpy(p, str.data(), str.size());
+      return std::string_view(p, str.size());
+    }
+  };
+
+  void publish(Id id, std::string_view str) {
+    auto& segment = segments[id >> kSegmentBits];
+    auto* p = segment.load(std::memory_order_acquire);
+    if (!p) {
+      // ids are handed out in order, but shards race for a new segment
+      auto* fresh = new std::string_view[kSegmentSize];
+      if (segment.compare_exchange_strong(p, fresh, std::memory_order_acq_rel)) {
+        p = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    // whoever got `id` from `intern` synchronized with this via the shard lock
+    p[id & (kSegmentSize - 1)] = str;
+  }
+
+  const std::size_t capacity;
+  std::atomic<Id> next{0};
+  Shard shards[kShards];
+  std::atomic<std::string_view*> segments[kSegments] = {};
+};
+
+/**
+ * one global lock around a std::unordered_map, for comparison
+ */
+class LockedInterner {
+ public:
+  using Id = std::uint32_t;
+  Id intern(std::string_view str) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto found = ids.find(std::string(str));
+    if (found != ids.end()) return found->second;
+    const Id id = static_cast<Id>(ids.size());
+    ids.emplace(std::string(str), id);
+    return id;
+  }
+
+ private:
+  std::mutex mutex;
+  std::unordered_map<std::string, Id> ids;
+};
+
+//
+
+int main() {
+  Interner interner;
+
+  // the names of Sandbox::Thing and Polymorphism::Base::method()
+  const auto apple = interner.intern("Apple");
+  const auto kiwi = interner.intern("Kiwi");
+  const auto base = interner.intern("Base::method");
+  CHECK("intern", (apple != kiwi && kiwi != base));
+  CHECK_VALUE("intern", interner.intern(std::string("Ap") + "ple"), apple);
+  CHECK_VALUE("intern", interner.intern("Base::method"), base);
+  CHECK_VALUE("view", interner.view(apple), "Apple");
+  CHECK_VALUE("view", interner.view(base), "Base::method");
+  CHECK_VALUE("size", interner.size(), 3);
+  CHECK_VALUE("empty", interner.view(interner.intern("")), "");
+
+  // large strings and many strings (arena chunks, table growth, segments)
+  const std::string large(100 * 1024, 'x');
+  const auto largeId = interner.intern(large);
+  std::vector<std::string> names;
+  for (int i = 0; i < 20000; ++i) names.push_back("Derived::method#" + std::to_string(i));
+  std::vector<Interner::Id> ids;
+  for (const auto& name : names) ids.push_back(interner.intern(name));
+  CHECK_VALUE("large", interner.view(largeId), large);
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    if (interner.view(ids[i]) != names[i] || interner.intern(names[i]) != ids[i]) {
+      CHECK_FAILED("many");
+    }
+  }
+
+  // running out of ids fails loudly, known strings still resolve
+  {
+    Interner small(2);
+    const auto first = small.intern("Apple");
+    small.intern("Kiwi");
+    try {
+      small.intern("Banana");
+      CHECK_FAILED("out of ids");
+    } catch (const std::length_error&) {
+    }
+    CHECK_VALUE("out of ids", small.intern("Apple"), first);
+    CHECK_VALUE("out of ids", small.size(), 2);
+  }
+
+  // concurrent interning of the same names yields the same ids
+  {
+    Interner shared;
+    std::vector<std::vector<Interner::Id>> seen(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < 5000; ++i) {
+          seen[t].push_back(shared.intern(names[(i * (t + 1)) % 5000]));
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK_VALUE("concurrent", shared.size(), 5000);
+    for (int t = 0; t < 4; ++t) {
+      for (int i = 0; i < 5000; ++i) {
+        if (shared.view(seen[t][i]) != names[(i * (t + 1)) % 5000]) {
+          CHECK_FAILED("concurrent");
+        }
+      }
+    }
+  }
+
+  // benchmark intern and view throughput. every worker takes its share of
+  // the items, through Harness::sweep from 1 to N pinned threads
+  // (`--sweep StringInterner`), the plain benchmarks are 1 thread
+  std::vector<std::string> workload;
+  for (int i = 0; i < 1 << 15; ++i) workload.push_back(names[(i * 7919) % 4096]);
+
+  // every 4th string is new in every run (a serial per worker), the others
+  // are hits on the names interned before
+  const std::size_t maxWorkers =
+      std::max({Harness::options().maxThreads, std::thread::hardware_concurrency(), 1u});
+  auto mixed = [&](auto& target) -> Harness::Workload {
+    for (const auto& name : names) target.intern(name);
+    auto serials = std::make_shared<std::vector<std::uint64_t>>(maxWorkers);
+    return [&target, &workload, serials](unsigned worker, unsigned workers) {
+      auto& serial = (*serials)[worker];
+      std::size_t sum = 0;
+      for (std::size_t i = worker; i < workload.size(); i += workers) {
+        if (i % 4) {
+          sum += target.intern(workload[i]);
+        } else {
+          Format::Buffer<48> fresh;
+          fresh << "Derived::method#" << worker << '.' << serial++;
+          sum += target.intern(fresh.view());
+        }
+      }
+      Harness::doNotOptimize(sum);
+    };
+  };
+  Interner sharded;
+  LockedInterner locked;
+  const auto shardedMixed = mixed(sharded);
+  const auto lockedMixed = mixed(locked);
+  Harness::benchmark("Interner::intern 25% misses", [&] { shardedMixed(0, 1); });
+  Harness::benchmark("LockedInterner::intern 25% misses", [&] { lockedMixed(0, 1); });
+  Harness::sweep("Interner::intern 25% misses", workload.size(), shardedMixed);
+  Harness::sweep("LockedInterner::intern 25% misses", workload.size(), lockedMixed);
+
+  Harness::benchmark("Interner::view", [&] {
+    std::size_t sum = 0;
+    for (auto id : ids) sum += interner.view(id).size();
+    Harness::doNotOptimize(sum);
+  });
+  Harness::sweep("Interner::view", ids.size(), [&](unsigned worker, unsigned workers) {
+    std::size_t sum = 0;
+    for (std::size_t i = worker; i < ids.size(); i += workers) sum += interner.view(ids[i]).size();
+    Harness::doNotOptimize(sum);
+  });
+
+  return 0;
+}
+
+}  // namespace StringInterner
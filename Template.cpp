@@ -1,4 +1,5 @@
 #include <tuple>
+#include <variant>
 
 #include "main.h"
 
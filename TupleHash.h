@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+/*
+ * hash of tuple keys, shared by FlatHashMap and Memoize: a fold over the
+ * element hashes, strings hashed as string views (so `std::tuple<std::string,
+ * int>` and `std::tuple<std::string_view, int>` hash equal), finished by the
+ * murmur3 mix
+ */
+
+/**
+ * transparent hash of tuples (and of single values)
+ */
+struct TupleHash {
+  using is_transparent = void;
+
+  template <typename T>
+  std::size_t operator()(const T& value) const {
+    return mix(element(value));
+  }
+
+  template <typename... Ts>
+  std::size_t operator()(const std::tuple<Ts...>& t) const {
+    return mix(std::apply(
+        [](const auto&... e) {
+          std::uint64_t h = 0;
+          ((h = (h << 5 | h >> 59) ^ element(e), h *= 0x9E3779B97F4A7C15ull), ...);
+          return h;
+        },
+        t));
+  }
+
+ private:
+  // equal strings hash equal, whatever their type
+  template <typename T>
+  static std::uint64_t element(const T& value) {
+    if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+      return std::hash<std::string_view>()(value);
+    } else {
+      return std::hash<T>()(value);
+    }
+  }
+
+  // std::hash of integers is the identity, but all bits are used (murmur3 finalizer)
+  static std::size_t mix(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return static_cast<std::size_t>(h);
+  }
+};
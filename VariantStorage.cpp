@@ -0,0 +1,242 @@
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "main.h"
+
+/*
+ * `std::vector<std::variant<Ts...>>` stores every element as the largest
+ * alternative plus its tag (and padding), and visiting it dispatches on the tag
+ * for every single element.
+ *
+ * `VariantVector<Ts...>` splits it up (structure of arrays):
+ * - tags in a separate byte array
+ * - payloads in one dense `std::vector` per alternative
+ * - per block of 64 elements the number of elements of each alternative before
+ *   it, to find the payload of element `i` (rank) for random access
+ *
+ * `visit` processes all elements of one alternative at a time: a tight loop
+ * over a dense array without dispatch, which the compiler can vectorize.
+ *
+ * https://en.cppreference.com/w/cpp/utility/variant
+ * https://en.wikipedia.org/wiki/AoS_and_SoA
+ */
+
+namespace VariantStorage {
+
+template <typename T, typename... Ts>
+constexpr std::size_t index_of() {
+  std::size_t i = 0;
+  const bool found = ((std::is_same_v<T, Ts> ? true : (++i, false)) || ...);
+  return found ? i : sizeof...(Ts);
+}
+
+template <typename... Ts, std::size_t... Is>
+constexpr bool unique_types(std::index_sequence<Is...>) {
+  return ((index_of<Ts, Ts...>() == Is) && ...);
+}
+
+template <typename... Ts>
+class VariantVector {
+  static_assert(sizeof...(Ts) > 0 && sizeof...(Ts) < 256, "tag is a byte");
+  static_assert(unique_types<Ts...>(std::index_sequence_for<Ts...>()),
+                "alternatives must be distinct");
+
+ public:
+  using Variant = std::variant<Ts...>;
+  static constexpr std::size_t kAlternatives = sizeof...(Ts);
+
+  template <typename T>
+  static constexpr std::size_t index_of_v = index_of<T, Ts...>();
+
+  template <typename T,
+            typename = std::enable_if_t<(index_of_v<std::decay_t<T>> < kAlternatives)>>
+  void push_back(T&& value) {
+    constexpr auto tag = index_of_v<std::decay_t<T>>;
+    if (tags.size() % kBlock == 0) ranks.push_back(counts);
+    tags.push_back(static_cast<std::uint8_t>(tag));
+    ++counts[tag];
+    std::get<tag>(payloads).push_back(std::forward<T>(value));
+  }
+
+  void push_back(const Variant& value) {
+    std::visit([this](const auto& v) { push_back(v); }, value);
+  }
+
+  std::size_t size() const { return tags.size(); }
+
+  // alternative index of element `i`, like std::variant::index
+  std::size_t index(std::size_t i) const { return tags[i]; }
+
+  // dense array of all elements holding `T`, in order
+  template <typename T>
+  const std::vector<T>& alternative() const {
+    return std::get<index_of_v<T>>(payloads);
+  }
+
+  Variant operator[](std::size_t i) const {
+    return get(i, std::index_sequence_for<Ts...>());
+  }
+
+  /**
+   * call `f` for every element, grouped by alternative:
+   * all elements of the first alternative (in order), then of the second, ...
+   */
+  template <typename F>
+  void visit(F&& f) const {
+    std::apply(
+        [&](const auto&... alternative) {
+          (..., [&] {
+            for (const auto& v : alternative) f(v);
+          }());
+        },
+        payloads);
+  }
+
+  /**
+   * call `f` for every element in order (like visiting the std::vector)
+   */
+  template <typename F>
+  void visit_in_order(F&& f) const {
+    std::array<std::size_t, kAlternatives> cursors{};
+    for (auto tag : tags) {
+      dispatch(tag, cursors, f, std::index_sequence_for<Ts...>());
+    }
+  }
+
+  // bytes of heap memory in use (without over-allocation)
+  std::size_t memory() const {
+    return tags.size() + ranks.size() * sizeof(Counts) +
+           std::apply([](const auto&... v) { return ((v.size() * sizeof(v[0])) + ...); },
+                      payloads);
+  }
+
+ private:
+  static constexpr std::size_t kBlock = 64;
+  using Counts = std::array<std::uint32_t, kAlternatives>;
+
+  // position of element `i` in the array of its alternative
+  std::size_t rank(std::size_t i) const {
+    const std::size_t block = i / kBlock;
+    const auto tag = tags[i];
+    std::size_t r = ranks[block][tag];
+    for (std::size_t j = block * kBlock; j < i; ++j) r += tags[j] == tag;
+    return r;
+  }
+
+  template <std::size_t... Is>
+  Variant get(std::size_t i, std::index_sequence<Is...>) const {
+    const auto tag = tags[i];
+    const auto r = rank(i);
+    Variant result;
+    ((tag == Is ? void(result.template emplace<Is>(std::get<Is>(payloads)[r])) : void()), ...);
+    return result;
+  }
+
+  template <typename F, std::size_t... Is>
+  void dispatch(std::size_t tag, std::array<std::size_t, kAlternatives>& cursors, F& f,
+                std::index_sequence<Is...>) const {
+    ((tag == Is ? void(f(std::get<Is>(payloads)[cursors[Is]++])) : void()), ...);
+  }
+
+  std::vector<std::uint8_t> tags;
+  std::vector<Counts> ranks;  // per block
+  Counts counts{};
+  std::tuple<std::vector<Ts>...> payloads;
+};
+
+//
+
+int main() {
+  VariantVector<int, double, std::string> v;
+  v.push_back(1);
+  v.push_back(2.5);
+  v.push_back(std::string("Apple"));
+  v.push_back(std::variant<int, double, std::string>(3));
+  v.push_back(std::variant<int, double, std::string>("Kiwi"));
+
+  CHECK_VALUE("size", v.size(), 5);
+  CHECK_VALUE("index", v.index(1), 1);
+  CHECK("operator[]", (v[0] == std::variant<int, double, std::string>(1)));
+  CHECK("operator[]", (v[3] == std::variant<int, double, std::string>(3)));
+  CHECK("operator[]", (v[4] == std::variant<int, double, std::string>("Kiwi")));
+  CHECK("alternative", (v.alternative<int>() == std::vector<int>{1, 3}));
+
+  // grouped by alternative
+  std::string grouped;
+  v.visit([&](const auto& x) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(x)>, std::string>) {
+      grouped += x;
+    } else {
+      grouped += std::to_string(static_cast<int>(x));
+    }
+    grouped += ',';
+  });
+  CHECK_VALUE("visit", grouped, "1,3,2,Apple,Kiwi,");
+
+  std::string ordered;
+  v.visit_in_order([&](const auto& x) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(x)>, std::string>) {
+      ordered += x;
+    } else {
+      ordered += std::to_string(static_cast<int>(x));
+    }
+    ordered += ',';
+  });
+  CHECK_VALUE("visit_in_order", ordered, "1,2,Apple,3,Kiwi,");
+
+  // the variant of Template::main
+  using Variant = std::variant<int, double>;
+  std::vector<Variant> aos;
+  VariantVector<int, double> soa;
+  std::mt19937 gen(42);
+  for (int i = 0; i < 1 << 18; ++i) {
+    const Variant x = gen() % 2 ? Variant(int(gen() % 100)) : Variant(gen() % 100 * 0.5);
+    aos.push_back(x);
+    soa.push_back(x);
+  }
+  for (std::size_t i = 0; i < aos.size(); i += 997) {
+    if (soa[i] != aos[i]) CHECK_FAILED("random access");
+  }
+
+  char line[128];
+  std::snprintf(line, sizeof(line),
+                "  [size] std::vector<std::variant>: %zu bytes, VariantVector: %zu bytes",
+                aos.size() * sizeof(Variant), soa.memory());
+  std::cout << line << std::endl;
+  CHECK("memory", (soa.memory() < aos.size() * sizeof(Variant)));
+
+  auto sum = [](double& s) { return [&s](const auto& x) { s += x; }; };
+  double expected = 0.0;
+  for (const auto& x : aos) std::visit(sum(expected), x);
+  double actual = 0.0;
+  soa.visit(sum(actual));
+  CHECK_VALUE("sum", actual, expected);
+
+  Harness::benchmark("std::visit", [&] {
+    double s = 0.0;
+    for (const auto& x : aos) std::visit(sum(s), x);
+    Harness::doNotOptimize(s);
+  });
+  Harness::benchmark("VariantVector::visit", [&] {
+    double s = 0.0;
+    soa.visit(sum(s));
+    Harness::doNotOptimize(s);
+  });
+  Harness::benchmark("VariantVector::visit_in_order", [&] {
+    double s = 0.0;
+    soa.visit_in_order(sum(s));
+    Harness::doNotOptimize(s);
+  });
+
+  return 0;
+}
+
+}  // namespace VariantStorage
@@ -4,7 +4,9 @@
 #include <vector>
 #include <iostream>
 
-int main() {
+int main(int argc, char** argv) {
+  Harness::parseOptions(argc, argv);
+
   RUN_TEST(FunctionPointer);
   RUN_TEST(UniversalReference);
   RUN_TEST(MostVexingParse);
@@ -19,4 +21,17 @@ int main() {
   RUN_TEST(Algorithm);
   RUN_TEST(Sandbox);
   RUN_TEST(DesignPattern);
-}
\ No newline at end of file
+  RUN_TEST(Coroutine);
+  RUN_TEST(Serialization);
+  RUN_TEST(FunctionRegistry);
+  RUN_TEST(StringInterner);
+  RUN_TEST(VariantStorage);
+  RUN_TEST(Compression);
+  RUN_TEST(ExpressionTemplate);
+  RUN_TEST(FlatHashMap);
+  RUN_TEST(Memoize);
+  RUN_TEST(Format);
+  RUN_TEST(SearchIndex);
+
+  return Harness::finish();
+}
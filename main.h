@@ -1,33 +1,208 @@
+#pragma once
+
+#include <cstdint>
 #include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <string>
+#include <vector>
+
+#include "Format.h"
+
+/*
+ * test and benchmark harness, see Harness.cpp
+ *
+ * https://man7.org/linux/man-pages/man2/perf_event_open.2.html
+ */
+
+namespace Harness {
+
+/**
+ * hardware counters of a measured region.
+ * `valid` is false if no counter could be opened (e.g. unprivileged container),
+ * a single unavailable counter is reported as -1.
+ */
+struct Counters {
+  bool valid = false;
+  std::int64_t cycles = -1;
+  std::int64_t instructions = -1;
+  std::int64_t l1dMisses = -1;
+  std::int64_t llcMisses = -1;
+  std::int64_t branchMisses = -1;
+
+  double ipc() const {
+    return (cycles > 0 && instructions >= 0) ? double(instructions) / cycles
+                                             : 0.0;
+  }
+};
+
+/**
+ * a perf_event_open group of counters, enabled and disabled together.
+ * counts the calling thread and the threads it starts after construction
+ * once they have exited, not threads which already existed (e.g. a pool).
+ * `stop` returns the counts since the matching `start`.
+ */
+class CounterGroup {
+ public:
+  CounterGroup();
+  ~CounterGroup();
+  CounterGroup(const CounterGroup&) = delete;
+  CounterGroup& operator=(const CounterGroup&) = delete;
+
+  void start();
+  Counters stop();
+
+ private:
+  static constexpr int kEvents = 5;
+  int fds[kEvents];
+  // { value, time_enabled, time_running } per event at `start`
+  std::uint64_t started[kEvents][3] = {};
+};
+
+/**
+ * `poolThreads`: the counters miss the work done on pre-existing threads
+ */
+void report(const std::string& title, double seconds, const Counters& counters,
+            bool poolThreads);
+
+/**
+ * command line options of the harness
+ *
+ *   --samples N                samples per benchmark (default 15)
+ *   --save-baseline FILE       append benchmark samples to a baseline
+ *   --compare-baseline FILE    compare benchmark samples against a baseline
+ *   --threshold X              tolerated slowdown of the median (default 0.10)
+ *   --alpha P                  significance level over all benchmarks
+ *                              (default 0.01, Holm-Bonferroni)
+ *   --sweep FILTER             run thread-count sweeps whose "<test>/<title>"
+ *                              contains FILTER ("" for all)
+ *   --placement P              pinning of sweep workers (default smt):
+ *                              none, compact, smt or numa
+ *   --max-threads N            largest thread count of a sweep (default: cpus)
+ */
+enum class Placement {
+  None,     // no pinning
+  Compact,  // fill the SMT siblings of a core before the next core
+  Smt,      // one worker per physical core first, then the siblings
+  Numa,     // round robin over NUMA nodes, SMT-aware within a node
+};
+
+struct Options {
+  int samples = 15;
+  std::string saveBaseline;
+  std::string compareBaseline;
+  double threshold = 0.10;
+  double alpha = 0.01;
+  bool sweep = false;
+  std::string sweepFilter;
+  Placement placement = Placement::Smt;
+  unsigned maxThreads = 0;
+};
+
+const Options& options();
+void parseOptions(int argc, char** argv);
+
+/**
+ * save or compare the baseline, return the exit code of the test binary:
+ * EXIT_FAILURE if any benchmark regressed significantly.
+ */
+int finish();
+
+/**
+ * one-sided Mann-Whitney U test, p-value of "`x` tends to be larger than `y`"
+ * (normal approximation with tie and continuity correction)
+ */
+double mannWhitneyGreater(const std::vector<double>& x,
+                          const std::vector<double>& y);
+
+/**
+ * RAII measurement of a scope, reported on destruction.
+ */
+class Measure {
+ public:
+  explicit Measure(std::string title);
+  ~Measure();
+
+ private:
+  std::string title;
+  std::string outerScope;
+  CounterGroup group;
+  std::int64_t startNs;
+};
+
+/**
+ * run `sample` repeatedly and report median wall time and counters.
+ * one call of `sample` is one sample, all sample times are recorded
+ * for the baseline under "<test>/<title>".
+ * threads started and joined by `sample` are counted, set `poolThreads` if
+ * the work runs on threads which already exist (the report says so).
+ */
+void benchmark(const std::string& title, const std::function<void()>& sample,
+               bool poolThreads = false);
+
+/**
+ * share of a sweep: `worker` of `workers` processes its part of the items
+ */
+using Workload = std::function<void(unsigned worker, unsigned workers)>;
+
+/**
+ * run `workload` pinned at thread counts 1, 2, 4 ... N and report throughput,
+ * speedup and parallel efficiency. only runs with `--sweep`.
+ */
+void sweep(const std::string& title, std::size_t items, const Workload& workload);
+
+/**
+ * keep the optimizer from discarding a result
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+  asm volatile("" : : "m"(value) : "memory");
+}
+
+}  // namespace Harness
 
 #define DECLARE_TEST(ns) \
   namespace ns {         \
   int main();            \
   }
 
-#define RUN_TEST(ns)                        \
-  do {                                      \
-    std::cout << "Test: " #ns << std::endl; \
-    ns::main();                             \
+#define RUN_TEST(ns)                   \
+  do {                                 \
+    Format::Buffer<128> line;          \
+    line << "Test: " #ns "\n";         \
+    Format::print(stdout, line);       \
+    Harness::Measure measure(#ns);     \
+    ns::main();                        \
   } while (0, 0)
 
 #define CHECK_VALUE(title, expected, actual)                          \
   do {                                                                \
     if ((expected) != (actual)) {                                     \
-      std::cerr << "[FAILED] [" << title << "] "                      \
-                << "expected: " << expected << ", actual: " << actual \
-                << std::endl;                                         \
+      Format::Buffer<1024> line; /* long values are cut off */        \
+      line << "[FAILED] [" << title << "] "                           \
+           << "expected: " << expected << ", actual: " << actual      \
+           << '\n';                                                   \
+      Format::print(stderr, line);                                    \
       exit(EXIT_FAILURE);                                             \
     }                                                                 \
   } while (0, 0)
 
 #define CHECK(title, pred) CHECK_VALUE(title, pred, true)
 
-#define CHECK_FAILED(title)                                 \
-  do {                                                      \
-    std::cerr << "[FAILED] [" << title << "]" << std::endl; \
-    exit(EXIT_FAILURE);                                     \
+#define CHECK_FAILED(title)                     \
+  do {                                          \
+    Format::Buffer<256> line;                   \
+    line << "[FAILED] [" << title << "]\n";     \
+    Format::print(stderr, line);                \
+    exit(EXIT_FAILURE);                         \
+  } while (0, 0)
+
+// a part of a test which this build can not run, e.g. C++20 only
+#define SKIPPED(title, reason)                                     \
+  do {                                                             \
+    Format::Buffer<256> line;                                      \
+    line << "  [skipped] " << title << ": " << reason << '\n';     \
+    Format::print(stdout, line);                                   \
   } while (0, 0)
 
 DECLARE_TEST(FunctionPointer)
@@ -44,3 +219,14 @@ DECLARE_TEST(Tuple)
 DECLARE_TEST(Algorithm)
 DECLARE_TEST(Sandbox)
 DECLARE_TEST(DesignPattern)
+DECLARE_TEST(Coroutine)
+DECLARE_TEST(Serialization)
+DECLARE_TEST(FunctionRegistry)
+DECLARE_TEST(StringInterner)
+DECLARE_TEST(VariantStorage)
+DECLARE_TEST(Compression)
+DECLARE_TEST(ExpressionTemplate)
+DECLARE_TEST(FlatHashMap)
+DECLARE_TEST(Memoize)
+DECLARE_TEST(Format)
+DECLARE_TEST(SearchIndex)